@@ -12,6 +12,8 @@
 #include "InternalPlugins/IInternalPlugin.h"
 #include "imgui_internal.h"
 #include "Utils/PerfUtils.h"
+#include "Core/JobSystem.h"
+#include <string.h>
 
 constexpr float IdealFrameRate = 60.f;
 constexpr float IdealFrameTime = 1.0f / IdealFrameRate;
@@ -44,14 +46,23 @@ AppCore::AppCore()
 AppCore::~AppCore() = default;
 
 // Init all engine subsystems
-void AppCore::Init()
+void AppCore::Init(const int32_t inArgc, const char* const* inArgv)
 {
 	BENCH_SCOPE("Engine Init");
 
 	GEngine = new AppCore{};
 
+	for (int32_t argIdx = 1; argIdx < inArgc; ++argIdx)
+	{
+		GEngine->CommandLineArgs.push_back(inArgv[argIdx]);
+	}
+
 	InputSystem::Init();
 
+	JobSystemConfig jobSystemConfig;
+	jobSystemConfig.ParseCommandLine(inArgc, inArgv);
+	JobSystem::Init(jobSystemConfig);
+
 	// Create Main Window
 	GEngine->MainWindow = eastl::make_unique<WindowsWindow>(true, WindowProperties(1920, 1080));
 
@@ -93,6 +104,8 @@ void AppCore::Terminate()
 
 	GEngine->CurrentApp->Terminate();
 
+	JobSystem::Terminate();
+
 	InputSystem::Terminate();
 
 	SceneManager::Terminate();
@@ -190,6 +203,19 @@ void AppCore::StopEngine()
 	bIsRunning = false;
 }
 
+bool AppCore::HasCommandLineArg(const char* inArg) const
+{
+	for (const eastl::string& arg : CommandLineArgs)
+	{
+		if (_stricmp(arg.c_str(), inArg) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 bool AppCore::IsImguiEnabled() const
 {
 	return !!GImGui;
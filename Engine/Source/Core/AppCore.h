@@ -14,13 +14,15 @@ public:
 	~AppCore();
 
 public:
-	static void Init();
+	static void Init(const int32_t inArgc = 0, const char* const* inArgv = nullptr);
 	static void Terminate();
 	void Run();
 	void CheckShouldCloseWindow();
 	bool IsRunning();
 	void StopEngine();
 	bool IsImguiEnabled() const;
+	// Case insensitive, the argument has to match as a whole, like -PinJobWorkers
+	bool HasCommandLineArg(const char* inArg) const;
 
 	class WindowsWindow& GetMainWindow() { return *MainWindow; }
 	inline PostInitCallback& GetPostInitMulticast() { return InitDoneMulticast; }
@@ -36,6 +38,8 @@ private:
 	class AppModeBase* CurrentApp = nullptr;
 	PostInitCallback InitDoneMulticast;
 	float CurrentDeltaT;
+	// Without the executable path
+	eastl::vector<eastl::string> CommandLineArgs;
 
 	// TODO 
 	// Engine core holds ownership over Window for now, it should be moved to application layer later
@@ -174,6 +174,14 @@ void AppModeBase::CreateInitialResources()
 
 	{
 		Rasterizer.Init(SoftRasterizerImgWidth, SoftRasterizerImgHeight);
+		Rasterizer.StartRenderThread();
+
+		// Lets the benchmark run unattended, its results go to the log
+		if (GEngine->HasCommandLineArg("-RasterizerScalingBenchmark"))
+		{
+			Rasterizer.RequestScalingBenchmark();
+		}
+
 		MainImage = eastl::make_shared<D3D12Texture2DWritable>(SoftRasterizerImgWidth, SoftRasterizerImgHeight, /*inSRGB*/ false, m_commandList);
 	}
 
@@ -418,15 +426,18 @@ void AppModeBase::BeginFrame()
 
 
 	{
-		Rasterizer.BeginFrame();
-
-		Rasterizer.DrawModel(MainModel);
+		// Rendering happens on the rasterizer's own thread, this only queues the next frame and uploads the last completed one
+		Rasterizer.SubmitFrame(MainModel);
 
-		//Rasterizer.DrawLine(glm::vec2(40, 30), glm::vec2(0, 30));
-
-		Rasterizer.PrepareBeforePresent();
-		uint32_t* imageData = Rasterizer.GetImage();
-		D3D12RHI::Get()->UpdateTexture2D(MainImage->GetCurrentImage(), imageData, SoftRasterizerImgWidth, SoftRasterizerImgHeight, m_commandList);
+		// Every frame in flight has its own texture, so the image is uploaded even when no new frame completed
+		// The presented frame is resolved straight into the upload buffer
+		if (Rasterizer.AcquireCompletedFrame())
+		{
+			D3D12RHI::Get()->UpdateTexture2D(MainImage->GetCurrentImage(), [](uint8_t* outTexels, const uint64_t inRowPitch)
+				{
+					Rasterizer.ResolvePresentedImage(outTexels, inRowPitch);
+				}, m_commandList);
+		}
 	}
 
 
@@ -527,6 +538,8 @@ void AppModeBase::EndFrame()
 
 void AppModeBase::Terminate()
 {
+	Rasterizer.StopRenderThread();
+
 	D3D12RHI::Terminate();
 
 	ASSERT(GameMode);
@@ -3,6 +3,6 @@
 
 int main(int argc, char** argv)
 {
-	AppCore::Init();
+	AppCore::Init(argc, argv);
 	GEngine->Run();
 }
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "Core/JobSystem.h"
+#include "Core/WindowsPlatform.h"
+#include "Logger/Logger.h"
+#include "EASTL/string.h"
+#include <string.h>
+#include <stdlib.h>
+
+JobSystem* JobSystem::Instance = nullptr;
+
+// Yields before a worker goes to sleep, jobs of a frame tend to come in bursts
+constexpr int32_t NUM_IDLE_SPINS = 256;
+
+// Bumped by every Init, a thread can outlive the job system that assigned its queue
+static uint32_t s_InstanceGeneration = 0;
+
+// Queue owned by the current thread, valid while Generation matches, see JobSystem::GetThreadQueueIdx
+// A thread that is not a worker hands its queue back when it exits, so threads can come and go
+struct JobThreadQueue
+{
+	int32_t QueueIdx = -1;
+	uint32_t Generation = 0;
+
+	~JobThreadQueue();
+};
+
+static thread_local JobThreadQueue t_ThreadQueue;
+
+JobThreadQueue::~JobThreadQueue()
+{
+	// Workers keep their queue for the whole life of the job system
+	JobSystem* jobSystem = JobSystem::Instance;
+	if (jobSystem && Generation == s_InstanceGeneration && QueueIdx >= jobSystem->NumWorkers)
+	{
+		jobSystem->ReleaseExternalQueue(QueueIdx);
+	}
+}
+
+void JobSystemConfig::ParseCommandLine(const int32_t inArgc, const char* const* inArgv)
+{
+	constexpr const char* numWorkersArg = "-JobWorkers=";
+	const size_t numWorkersArgLength = strlen(numWorkersArg);
+
+	for (int32_t argIdx = 1; argIdx < inArgc; ++argIdx)
+	{
+		const char* arg = inArgv[argIdx];
+		if (_strnicmp(arg, numWorkersArg, numWorkersArgLength) == 0)
+		{
+			NumWorkers = atoi(arg + numWorkersArgLength);
+		}
+		else if (_stricmp(arg, "-PinJobWorkers") == 0)
+		{
+			bPinWorkers = true;
+		}
+	}
+}
+
+void JobSystem::Init(const JobSystemConfig& inConfig)
+{
+	ASSERT(!Instance);
+
+	++s_InstanceGeneration;
+	Instance = new JobSystem(inConfig);
+}
+
+void JobSystem::Terminate()
+{
+	ASSERT(Instance);
+
+	delete Instance;
+	Instance = nullptr;
+}
+
+JobSystem::JobSystem(const JobSystemConfig& inConfig)
+{
+	const eastl::vector<ProcessorCoreInfo> cores = WindowsPlatform::GetPhysicalCores();
+
+	NumWorkers = inConfig.NumWorkers;
+	if (NumWorkers < 0)
+	{
+		// Logical processors if the topology is unknown
+		const int32_t numCores = cores.empty() ? static_cast<int32_t>(std::thread::hardware_concurrency()) : static_cast<int32_t>(cores.size());
+		NumWorkers = eastl::max(numCores - 1, 0);
+	}
+
+	NumActiveWorkers.store(NumWorkers);
+
+	for (int32_t queueIdx = 0; queueIdx < NumWorkers + MAX_EXTERNAL_THREADS; ++queueIdx)
+	{
+		Queues.push_back(eastl::make_unique<JobQueue>());
+	}
+
+	// Handed out from the back, lowest index first
+	for (int32_t queueIdx = NumWorkers + MAX_EXTERNAL_THREADS - 1; queueIdx >= NumWorkers; --queueIdx)
+	{
+		FreeExternalQueues.push_back(queueIdx);
+	}
+
+	const bool bPinWorkers = inConfig.bPinWorkers && !cores.empty();
+	bWorkersPinned = bPinWorkers;
+	for (int32_t workerIdx = 0; workerIdx < NumWorkers; ++workerIdx)
+	{
+		std::thread newThread = std::thread(&JobSystem::WorkerRun, this, workerIdx);
+
+		eastl::wstring threadName = L"Job System Worker ";
+		threadName += eastl::to_wstring(workerIdx);
+
+		SetThreadDescription(newThread.native_handle(), threadName.c_str());
+
+		// The main thread runs on the first core, see WindowsPlatform::InitCycles
+		if (bPinWorkers)
+		{
+			WindowsPlatform::SetThreadCoreAffinity(newThread.native_handle(), cores[(workerIdx + 1) % cores.size()]);
+		}
+
+		Workers.push_back(std::move(newThread));
+	}
+
+	LOG_INFO("Job system: %d workers, %d physical cores detected, workers pinned: %d", NumWorkers, static_cast<int32_t>(cores.size()), bPinWorkers ? 1 : 0);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::unique_lock lock(SleepMutex);
+		bStopping.store(true);
+		SleepCondition.notify_all();
+	}
+
+	for (std::thread& worker : Workers)
+	{
+		worker.join();
+	}
+
+	// Whoever queued jobs had to wait on them
+	ASSERT(NumQueuedJobs.load() == 0);
+}
+
+void JobSystem::Run(JobCounter& ioCounter, JobFunction inJob)
+{
+	PushJob(GetThreadQueueIdx(), ioCounter, eastl::move(inJob));
+
+	WakeWorkers(false);
+}
+
+void JobSystem::SetNumActiveWorkers(const int32_t inNumActiveWorkers)
+{
+	std::unique_lock lock(SleepMutex);
+	NumActiveWorkers.store(eastl::max(eastl::min(inNumActiveWorkers, NumWorkers), 0));
+	SleepCondition.notify_all();
+}
+
+void JobSystem::PushJob(const int32_t inQueueIdx, JobCounter& ioCounter, JobFunction inJob)
+{
+	ioCounter.NumPendingJobs.fetch_add(1, std::memory_order_relaxed);
+
+	JobQueue& queue = *Queues[inQueueIdx];
+	{
+		std::unique_lock lock(queue.Mutex);
+		queue.Jobs.push_back(Job{ eastl::move(inJob), &ioCounter });
+	}
+
+	NumQueuedJobs.fetch_add(1);
+}
+
+void JobSystem::WakeWorkers(const bool inWakeAll)
+{
+	// Workers only sleep while holding the mutex and after finding nothing queued, so they can not miss this
+	if (NumSleepingWorkers.load() == 0)
+	{
+		return;
+	}
+
+	std::unique_lock lock(SleepMutex);
+	if (inWakeAll)
+	{
+		SleepCondition.notify_all();
+	}
+	else
+	{
+		SleepCondition.notify_one();
+	}
+}
+
+void JobSystem::Wait(JobCounter& inCounter)
+{
+	const int32_t queueIdx = GetThreadQueueIdx();
+
+	// Threads that are not workers only steal the jobs they wait on, a job of another thread could take much longer than
+	// the wait itself, like the main thread picking up the render thread's tiles while it resolves the frame to present
+	const JobCounter* stealCounter = queueIdx >= NumWorkers ? &inCounter : nullptr;
+	while (!inCounter.IsDone())
+	{
+		// Jobs left are already running on other threads
+		if (!TryRunJob(queueIdx, stealCounter))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerRun(const int32_t inWorkerIdx)
+{
+	t_ThreadQueue.QueueIdx = inWorkerIdx;
+	t_ThreadQueue.Generation = s_InstanceGeneration;
+
+	int32_t numIdleSpins = 0;
+	while (!bStopping.load())
+	{
+		const bool bActive = inWorkerIdx < NumActiveWorkers.load();
+		if (bActive && TryRunJob(inWorkerIdx))
+		{
+			numIdleSpins = 0;
+			continue;
+		}
+
+		if (bActive && numIdleSpins++ < NUM_IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		numIdleSpins = 0;
+
+		std::unique_lock lock(SleepMutex);
+		NumSleepingWorkers.fetch_add(1);
+		SleepCondition.wait(lock, [this, inWorkerIdx]()
+			{
+				return (inWorkerIdx < NumActiveWorkers.load() && NumQueuedJobs.load() > 0) || bStopping.load();
+			});
+		NumSleepingWorkers.fetch_sub(1);
+	}
+}
+
+int32_t JobSystem::GetThreadQueueIdx()
+{
+	if (t_ThreadQueue.Generation != s_InstanceGeneration)
+	{
+		std::unique_lock lock(ExternalQueuesMutex);
+		ASSERT_MSG(!FreeExternalQueues.empty(), "Job system: more than %d threads that are not workers use it at the same time", MAX_EXTERNAL_THREADS);
+
+		t_ThreadQueue.QueueIdx = FreeExternalQueues.back();
+		t_ThreadQueue.Generation = s_InstanceGeneration;
+		FreeExternalQueues.pop_back();
+	}
+
+	return t_ThreadQueue.QueueIdx;
+}
+
+void JobSystem::ReleaseExternalQueue(const int32_t inQueueIdx)
+{
+	{
+		// The thread waited on everything it queued before exiting
+		JobQueue& queue = *Queues[inQueueIdx];
+		std::unique_lock lock(queue.Mutex);
+		ASSERT(queue.Jobs.empty());
+	}
+
+	std::unique_lock lock(ExternalQueuesMutex);
+	FreeExternalQueues.push_back(inQueueIdx);
+}
+
+bool JobSystem::TryRunJob(const int32_t inQueueIdx, const JobCounter* inStealCounter)
+{
+	Job job;
+	if (!TryPopJob(inQueueIdx, job) && !TryStealJob(inQueueIdx, inStealCounter, job))
+	{
+		return false;
+	}
+
+	job.Function();
+
+	job.Counter->NumPendingJobs.fetch_sub(1, std::memory_order_release);
+
+	return true;
+}
+
+bool JobSystem::TryPopJob(const int32_t inQueueIdx, Job& outJob)
+{
+	JobQueue& queue = *Queues[inQueueIdx];
+
+	std::unique_lock lock(queue.Mutex);
+	if (queue.Jobs.empty())
+	{
+		return false;
+	}
+
+	// Newest first, its data is most likely still in cache
+	outJob = eastl::move(queue.Jobs.back());
+	queue.Jobs.pop_back();
+	NumQueuedJobs.fetch_sub(1);
+
+	return true;
+}
+
+bool JobSystem::TryStealJob(const int32_t inQueueIdx, const JobCounter* inCounter, Job& outJob)
+{
+	const int32_t numQueues = static_cast<int32_t>(Queues.size());
+	for (int32_t offset = 1; offset < numQueues; ++offset)
+	{
+		JobQueue& queue = *Queues[(inQueueIdx + offset) % numQueues];
+
+		std::unique_lock lock(queue.Mutex);
+
+		// Oldest first, for ParallelFor that is the largest range left
+		// A thread only stealing the jobs of its counter leaves the queue alone unless one of them is at the front
+		if (queue.Jobs.empty() || (inCounter && queue.Jobs.front().Counter != inCounter))
+		{
+			continue;
+		}
+
+		outJob = eastl::move(queue.Jobs.front());
+		queue.Jobs.pop_front();
+		NumQueuedJobs.fetch_sub(1);
+
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "EASTL/functional.h"
+#include "EASTL/vector.h"
+#include "EASTL/deque.h"
+#include "EASTL/unique_ptr.h"
+#include "EASTL/algorithm.h"
+#include "EASTL/utility.h"
+#include "Core/EngineUtils.h"
+
+using JobFunction = eastl::function<void()>;
+
+// Number of unfinished jobs of a group, every job run with the counter decrements it once done
+struct JobCounter
+{
+	std::atomic<int32_t> NumPendingJobs = ATOMIC_VAR_INIT(0);
+
+	inline bool IsDone() const { return NumPendingJobs.load(std::memory_order_acquire) == 0; }
+};
+
+struct JobSystemConfig
+{
+	// -1 for one worker per physical core but one, left to the threads that wait on jobs
+	int32_t NumWorkers = -1;
+	// Pins every worker to its own physical core, the first core is left to the main thread
+	bool bPinWorkers = false;
+
+	// Reads -JobWorkers=N and -PinJobWorkers
+	void ParseCommandLine(const int32_t inArgc, const char* const* inArgv);
+};
+
+// Work stealing job system
+// Every worker owns a deque, it pushes and pops its own jobs at the back while idle workers steal from the front of the others.
+// Threads that are not workers, like the main thread, get a deque of their own the first time they queue or wait on jobs
+// and give it back when they exit, so the jobs of one such thread never end up in the deque another one pops from.
+// A thread waiting on a counter runs jobs until the counter is done, so jobs can wait on other jobs and everything still runs
+// without any worker. While waiting, workers steal any job but other threads only steal the jobs of the counter they wait on.
+// Idle workers spin for a while before going to sleep until new jobs are queued.
+class JobSystem
+{
+public:
+	static void Init(const JobSystemConfig& inConfig = JobSystemConfig());
+	static void Terminate();
+	static inline JobSystem& Get() { ASSERT(Instance); return *Instance; }
+
+public:
+	void Run(JobCounter& ioCounter, JobFunction inJob);
+	void Wait(JobCounter& inCounter);
+
+	// Calls inFunction(begin, end) for sub ranges covering [0, inCount) in parallel, returns once all of them are done
+	// The range is split in halves down to a few chunks per thread and no less than inMinChunkSize, this thread keeps the lower halves
+	// so neighbouring chunks tend to run on the same thread while the larger upper halves are stolen first
+	template<typename FunctionType>
+	void ParallelFor(const int32_t inCount, const int32_t inMinChunkSize, const FunctionType& inFunction);
+
+	// Same as ParallelFor, but the range is first cut in one part per active worker plus one for this thread, always in the same way,
+	// and each part is queued on its worker's own deque. Unless it gets stolen, a worker gets the same part on every call,
+	// so what it touched last call is still in its caches
+	template<typename FunctionType>
+	void ParallelForWithAffinity(const int32_t inCount, const int32_t inMinChunkSize, const FunctionType& inFunction);
+
+	inline int32_t GetNumWorkers() const { return NumWorkers; }
+	inline bool AreWorkersPinned() const { return bWorkersPinned; }
+	inline int32_t GetNumActiveWorkers() const { return NumActiveWorkers.load(); }
+	// Workers past the count sleep and take no jobs, for measuring how work scales with the number of threads
+	void SetNumActiveWorkers(const int32_t inNumActiveWorkers);
+
+private:
+	friend struct JobThreadQueue;
+
+	JobSystem(const JobSystemConfig& inConfig);
+	~JobSystem();
+
+	struct Job
+	{
+		JobFunction Function;
+		JobCounter* Counter = nullptr;
+	};
+
+	struct alignas(64) JobQueue
+	{
+		std::mutex Mutex;
+		eastl::deque<Job> Jobs;
+	};
+
+	template<typename FunctionType>
+	struct ParallelForContext
+	{
+		JobCounter Counter;
+		const FunctionType* Function = nullptr;
+		int32_t ChunkSize = 1;
+	};
+
+	template<typename FunctionType>
+	void RunParallelForRange(ParallelForContext<FunctionType>& inContext, const int32_t inBegin, int32_t inEnd);
+
+	void PushJob(const int32_t inQueueIdx, JobCounter& ioCounter, JobFunction inJob);
+	void WakeWorkers(const bool inWakeAll);
+	void WorkerRun(const int32_t inWorkerIdx);
+	// Assigns the calling thread a free queue the first time it is called from a thread that is not a worker
+	int32_t GetThreadQueueIdx();
+	// Called when a thread that is not a worker exits, see JobThreadQueue
+	void ReleaseExternalQueue(const int32_t inQueueIdx);
+	// Pops from the thread's own queue first, then steals, only jobs of inStealCounter unless it is null
+	bool TryRunJob(const int32_t inQueueIdx, const JobCounter* inStealCounter = nullptr);
+	bool TryPopJob(const int32_t inQueueIdx, Job& outJob);
+	bool TryStealJob(const int32_t inQueueIdx, const JobCounter* inCounter, Job& outJob);
+
+private:
+	static JobSystem* Instance;
+
+	// Threads other than the workers that can use the job system at the same time, the main and the render thread in practice
+	static constexpr int32_t MAX_EXTERNAL_THREADS = 8;
+
+	int32_t NumWorkers = 0;
+	bool bWorkersPinned = false;
+	std::atomic<int32_t> NumActiveWorkers = ATOMIC_VAR_INIT(0);
+	// One per worker, then one per other thread, see GetThreadQueueIdx
+	eastl::vector<eastl::unique_ptr<JobQueue>> Queues;
+	// Queues past the workers' that no thread owns
+	std::mutex ExternalQueuesMutex;
+	eastl::vector<int32_t> FreeExternalQueues;
+	eastl::vector<std::thread> Workers;
+
+	std::atomic<int32_t> NumQueuedJobs = ATOMIC_VAR_INIT(0);
+	std::atomic<int32_t> NumSleepingWorkers = ATOMIC_VAR_INIT(0);
+	std::atomic<bool> bStopping = ATOMIC_VAR_INIT(false);
+	std::mutex SleepMutex;
+	std::condition_variable SleepCondition;
+};
+
+template<typename FunctionType>
+void JobSystem::ParallelFor(const int32_t inCount, const int32_t inMinChunkSize, const FunctionType& inFunction)
+{
+	if (inCount <= 0)
+	{
+		return;
+	}
+
+	// About 4 chunks per thread, so that threads that finish early still have something to steal
+	const int32_t numThreads = NumActiveWorkers.load() + 1;
+
+	ParallelForContext<FunctionType> context;
+	context.Function = &inFunction;
+	context.ChunkSize = eastl::max(eastl::max(inMinChunkSize, 1), inCount / (numThreads * 4));
+
+	RunParallelForRange(context, 0, inCount);
+
+	Wait(context.Counter);
+}
+
+template<typename FunctionType>
+void JobSystem::ParallelForWithAffinity(const int32_t inCount, const int32_t inMinChunkSize, const FunctionType& inFunction)
+{
+	if (inCount <= 0)
+	{
+		return;
+	}
+
+	const int32_t numWorkers = NumActiveWorkers.load();
+	const int32_t numParts = numWorkers + 1;
+
+	ParallelForContext<FunctionType> context;
+	context.Function = &inFunction;
+	context.ChunkSize = eastl::max(eastl::max(inMinChunkSize, 1), inCount / (numParts * 4));
+
+	ParallelForContext<FunctionType>* contextPtr = &context;
+	for (int32_t workerIdx = 0; workerIdx < numWorkers; ++workerIdx)
+	{
+		const int32_t begin = static_cast<int32_t>(static_cast<int64_t>(inCount) * workerIdx / numParts);
+		const int32_t end = static_cast<int32_t>(static_cast<int64_t>(inCount) * (workerIdx + 1) / numParts);
+		if (begin == end)
+		{
+			continue;
+		}
+
+		PushJob(workerIdx, context.Counter, [contextPtr, begin, end]()
+			{
+				Get().RunParallelForRange(*contextPtr, begin, end);
+			});
+	}
+
+	// Every worker has a part of its own
+	WakeWorkers(true);
+
+	RunParallelForRange(context, static_cast<int32_t>(static_cast<int64_t>(inCount) * numWorkers / numParts), inCount);
+
+	Wait(context.Counter);
+}
+
+template<typename FunctionType>
+void JobSystem::RunParallelForRange(ParallelForContext<FunctionType>& inContext, const int32_t inBegin, int32_t inEnd)
+{
+	while (inEnd - inBegin > inContext.ChunkSize)
+	{
+		const int32_t mid = inBegin + (inEnd - inBegin) / 2;
+		const int32_t end = inEnd;
+
+		// Captures stay small enough for the function's inline storage
+		ParallelForContext<FunctionType>* context = &inContext;
+		Run(inContext.Counter, [context, mid, end]()
+			{
+				Get().RunParallelForRange(*context, mid, end);
+			});
+
+		inEnd = mid;
+	}
+
+	(*inContext.Function)(inBegin, inEnd);
+}
@@ -0,0 +1,196 @@
+#include "Core/SoftwareOcclusionCuller.h"
+#include "Math/PolygonClipping.h"
+#include <limits>
+
+void SoftwareOcclusionCuller::Init(const int32_t inWidth, const int32_t inHeight)
+{
+	Width = inWidth;
+	Height = inHeight;
+	DepthData.resize(inWidth * inHeight);
+
+	Clear();
+}
+
+void SoftwareOcclusionCuller::Clear()
+{
+	// Workaround for windef macro causing compilation issues: https://stackoverflow.com/questions/1394132/macro-and-member-function-conflict
+	constexpr float maxDepth = (std::numeric_limits<float>::max)();
+	for (float& depth : DepthData)
+	{
+		depth = maxDepth;
+	}
+}
+
+void SoftwareOcclusionCuller::RasterizeOccluder(const eastl::vector<SimpleVertex>& inVertices, const eastl::vector<uint32_t>& inIndices, const glm::mat4& inObjectToClip)
+{
+	ClipSpaceVertices.resize(inVertices.size());
+	for (size_t i = 0; i < inVertices.size(); ++i)
+	{
+		ClipSpaceVertices[i] = inObjectToClip * glm::vec4(inVertices[i].Position, 1.f);
+	}
+
+	// Near plane of the standard depth range, the occlusion buffer never uses reversed Z
+	const glm::vec4 nearPlane(0.f, 0.f, 1.f, 0.f);
+
+	for (size_t idxStart = 0; idxStart + 2 < inIndices.size(); idxStart += 3)
+	{
+		const glm::vec4& A = ClipSpaceVertices[inIndices[idxStart]];
+		const glm::vec4& B = ClipSpaceVertices[inIndices[idxStart + 1]];
+		const glm::vec4& C = ClipSpaceVertices[inIndices[idxStart + 2]];
+
+		if (A.z >= 0.f && B.z >= 0.f && C.z >= 0.f)
+		{
+			RasterizeOccluderTriangle(A, B, C);
+			continue;
+		}
+
+		// Triangles crossing the near plane still occlude with the part in front of the camera, which is the part nearest to it
+		const glm::vec4 triangle[3] = { A, B, C };
+		glm::vec4 clipped[4];
+		const int32_t numVertices = ClipPolygonAgainstPlane(triangle, 3, nearPlane, clipped);
+		for (int32_t i = 1; i + 1 < numVertices; ++i)
+		{
+			RasterizeOccluderTriangle(clipped[0], clipped[i], clipped[i + 1]);
+		}
+	}
+}
+
+void SoftwareOcclusionCuller::RasterizeOccluderTriangle(const glm::vec4& inA, const glm::vec4& inB, const glm::vec4& inC)
+{
+	// Pixel space, pixel (x, y) covers [x, x + 1] x [y, y + 1]
+	const glm::vec2 halfSize(Width * 0.5f, Height * 0.5f);
+	const glm::vec3 A(glm::vec2(inA) / inA.w * halfSize + halfSize, inA.z / inA.w);
+	const glm::vec3 B(glm::vec2(inB) / inB.w * halfSize + halfSize, inB.z / inB.w);
+	const glm::vec3 C(glm::vec2(inC) / inC.w * halfSize + halfSize, inC.z / inC.w);
+
+	const glm::vec2 V0 = glm::vec2(B) - glm::vec2(A);
+	const glm::vec2 V1 = glm::vec2(C) - glm::vec2(A);
+	float det = V0.x * V1.y - V1.x * V0.y;
+	if (!(glm::abs(det) > 0.f))
+	{
+		return;
+	}
+
+	// Edge functions positive inside regardless of winding, both sides of an occluder occlude
+	const float orientation = det > 0.f ? 1.f : -1.f;
+	det *= orientation;
+
+	struct OccluderEdge
+	{
+		float StepX, StepY, Origin;
+	};
+
+	const glm::vec2 verts[3] = { glm::vec2(A), glm::vec2(B), glm::vec2(C) };
+	OccluderEdge edges[3];
+	for (int32_t i = 0; i < 3; ++i)
+	{
+		const glm::vec2& start = verts[(i + 1) % 3];
+		const glm::vec2& end = verts[(i + 2) % 3];
+		edges[i].StepX = orientation * (start.y - end.y);
+		edges[i].StepY = orientation * (end.x - start.x);
+		edges[i].Origin = orientation * (start.x * end.y - start.y * end.x);
+	}
+
+	// Depth plane, z = DepthStepX * x + DepthStepY * y + DepthOrigin
+	const float oneOverDet = 1.f / (orientation * det);
+	const float dz0 = B.z - A.z;
+	const float dz1 = C.z - A.z;
+	const float depthStepX = (dz0 * V1.y - dz1 * V0.y) * oneOverDet;
+	const float depthStepY = (dz1 * V0.x - dz0 * V1.x) * oneOverDet;
+	const float depthOrigin = A.z - depthStepX * A.x - depthStepY * A.y;
+	const float triangleMaxDepth = glm::max(A.z, glm::max(B.z, C.z));
+
+	// Pixels whose center is inside the bounding box
+	// Vertices clipped at the near plane can project far off the buffer, so the bounds are clamped before converting them
+	const glm::vec2 boundsMin = glm::clamp(glm::min(glm::vec2(A), glm::min(glm::vec2(B), glm::vec2(C))), glm::vec2(0.f), glm::vec2(Width, Height));
+	const glm::vec2 boundsMax = glm::clamp(glm::max(glm::vec2(A), glm::max(glm::vec2(B), glm::vec2(C))), glm::vec2(0.f), glm::vec2(Width, Height));
+	const int32_t minX = static_cast<int32_t>(glm::ceil(boundsMin.x - 0.5f));
+	const int32_t minY = static_cast<int32_t>(glm::ceil(boundsMin.y - 0.5f));
+	const int32_t maxX = glm::min(Width - 1, static_cast<int32_t>(glm::floor(boundsMax.x - 0.5f)));
+	const int32_t maxY = glm::min(Height - 1, static_cast<int32_t>(glm::floor(boundsMax.y - 0.5f)));
+
+	// Depth is linear, so its max over a pixel is at the corner picked by the sign of the steps
+	const float depthMaxOffset = glm::max(depthStepX, 0.f) + glm::max(depthStepY, 0.f);
+
+	for (int32_t y = minY; y <= maxY; ++y)
+	{
+		for (int32_t x = minX; x <= maxX; ++x)
+		{
+			const float fx = static_cast<float>(x);
+			const float fy = static_cast<float>(y);
+
+			bool bCovered = true;
+			for (int32_t i = 0; i < 3; ++i)
+			{
+				bCovered &= edges[i].StepX * (fx + 0.5f) + edges[i].StepY * (fy + 0.5f) + edges[i].Origin >= 0.f;
+			}
+
+			if (!bCovered)
+			{
+				continue;
+			}
+
+			const float pixelMaxDepth = glm::min(triangleMaxDepth, depthStepX * fx + depthStepY * fy + depthOrigin + depthMaxOffset);
+
+			float& depth = DepthData[y * Width + x];
+			depth = glm::min(depth, pixelMaxDepth);
+		}
+	}
+}
+
+bool SoftwareOcclusionCuller::IsOccluded(const AABB& inBox, const glm::mat4& inObjectToClip) const
+{
+	const eastl::array<glm::vec3, 8> corners = inBox.GetVertices();
+
+	constexpr float maxFloat = (std::numeric_limits<float>::max)();
+	glm::vec2 screenMin(maxFloat);
+	glm::vec2 screenMax(-maxFloat);
+	float nearestDepth = maxFloat;
+	for (const glm::vec3& corner : corners)
+	{
+		const glm::vec4 clipSpaceCorner = inObjectToClip * glm::vec4(corner, 1.f);
+
+		// Box crosses the near plane, its screen rect is unbounded
+		if (clipSpaceCorner.z < 0.f)
+		{
+			return false;
+		}
+
+		const glm::vec3 ndc = glm::vec3(clipSpaceCorner) / clipSpaceCorner.w;
+		screenMin = glm::min(screenMin, glm::vec2(ndc));
+		screenMax = glm::max(screenMax, glm::vec2(ndc));
+		nearestDepth = glm::min(nearestDepth, ndc.z);
+	}
+
+	// Every pixel the rect touches has to hold an occluder nearer than the box
+	const glm::vec2 halfSize(Width * 0.5f, Height * 0.5f);
+	const glm::vec2 pixelMin = screenMin * halfSize + halfSize;
+	const glm::vec2 pixelMax = screenMax * halfSize + halfSize;
+
+	const int32_t minX = static_cast<int32_t>(glm::floor(pixelMin.x));
+	const int32_t minY = static_cast<int32_t>(glm::floor(pixelMin.y));
+	const int32_t maxX = static_cast<int32_t>(glm::floor(pixelMax.x));
+	const int32_t maxY = static_cast<int32_t>(glm::floor(pixelMax.y));
+
+	if (maxX < 0 || maxY < 0 || minX >= Width || minY >= Height)
+	{
+		// Off screen, left to frustum culling
+		return false;
+	}
+
+	// Occluder pixels only sample coverage at their center, so one on a silhouette can be flagged while the box is still visible
+	// in the part the occluder misses. The pixel next to it across the silhouette has its center outside of the occluder,
+	// so testing a pixel more around the rect catches that.
+	for (int32_t y = glm::max(minY - 1, 0); y <= glm::min(maxY + 1, Height - 1); ++y)
+	{
+		for (int32_t x = glm::max(minX - 1, 0); x <= glm::min(maxX + 1, Width - 1); ++x)
+		{
+			if (DepthData[y * Width + x] >= nearestDepth)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include "glm/glm.hpp"
+#include "EASTL/vector.h"
+#include "Math/AABB.h"
+#include "Renderer/RenderingPrimitives.h"
+
+// Low resolution depth buffer that occluders are rasterized into, then used to test bounding boxes against.
+// Coverage is sampled at pixel centers so that meshes occlude without gaps along their shared edges, while the depth written
+// is conservative: the furthest the triangle gets over the whole pixel. Boxes are tested against every pixel they touch
+// and the ring of pixels around them, which makes up for occluder pixels only partly covered along silhouettes.
+// Occluder triangles crossing the near plane are clipped against it. Depth is NDC z in [0, 1] with nearer being smaller, same as the main depth buffer.
+class SoftwareOcclusionCuller
+{
+public:
+	SoftwareOcclusionCuller() = default;
+	void Init(const int32_t inWidth, const int32_t inHeight);
+	void Clear();
+
+	void RasterizeOccluder(const eastl::vector<SimpleVertex>& inVertices, const eastl::vector<uint32_t>& inIndices, const glm::mat4& inObjectToClip);
+	bool IsOccluded(const AABB& inBox, const glm::mat4& inObjectToClip) const;
+
+	inline int32_t GetWidth() const { return Width; }
+	inline int32_t GetHeight() const { return Height; }
+
+private:
+	void RasterizeOccluderTriangle(const glm::vec4& inA, const glm::vec4& inB, const glm::vec4& inC);
+
+private:
+	eastl::vector<float> DepthData;
+	// Occluder vertices in clip space, reused between occluders
+	eastl::vector<glm::vec4> ClipSpaceVertices;
+	int32_t Width = 0;
+	int32_t Height = 0;
+};
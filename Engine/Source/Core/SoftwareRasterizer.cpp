@@ -13,7 +13,16 @@
 #include "Scene/SceneManager.h"
 #include <limits>
 #include <thread>
+#include <mutex>
 #include "AppCore.h"
+#include "Math/SIMD.h"
+#include "EASTL/sort.h"
+#include "EASTL/algorithm.h"
+#include <chrono>
+#include "Core/JobSystem.h"
+#include "Math/PolygonClipping.h"
+#include "glm/gtc/packing.hpp"
+#include <type_traits>
 
 static uint32_t ConvertToRGBA(const glm::vec4& color)
 {
@@ -42,313 +51,705 @@ static glm::vec3 randomVec3() {
 }
 
 
-// boost style barrier
-struct Barrier
+constexpr int32_t PIXEL_QUAD_LENGTH = 2; // Always square, PIXEL_QUAD_LENGTH pixels on X and PIXEL_QUAD_LENGTH pixels on Y
+constexpr int32_t BIN_TILE_SIZE = 32; // Always square, screen is split in tiles of BIN_TILE_SIZE x BIN_TILE_SIZE pixels for binning
+constexpr int32_t RASTER_BLOCK_SIZE = 8; // Always square, triangles are traversed in blocks of RASTER_BLOCK_SIZE x RASTER_BLOCK_SIZE pixels inside a tile
+constexpr int32_t HIZ_BLOCK_SIZE = RASTER_BLOCK_SIZE; // Always square, Hi-Z keeps the max depth of each HIZ_BLOCK_SIZE x HIZ_BLOCK_SIZE block of pixels
+constexpr int32_t OCCLUSION_BUFFER_WIDTH = 256;
+constexpr int32_t OCCLUSION_BUFFER_HEIGHT = 128;
+constexpr int32_t GUARD_BAND_PIXELS = MAX_SUBPIXEL_COORD / SUBPIXEL_SCALE / 2; // Pixels past each side of the screen that triangles can extend to before being clipped
+
+static_assert(RASTER_BLOCK_SIZE == SIMD::Width, "A block row is processed as one SIMD batch");
+static_assert(BIN_TILE_SIZE % RASTER_BLOCK_SIZE == 0, "Blocks should not straddle tiles");
+static_assert(HIZ_BLOCK_SIZE == RASTER_BLOCK_SIZE, "Hi-Z is tested and updated per raster block");
+static_assert(BIN_TILE_SIZE % HIZ_BLOCK_SIZE == 0, "Tiles are cleared along with their Hi-Z blocks");
+
+constexpr int32_t RASTER_BLOCK_PIXELS = RASTER_BLOCK_SIZE * RASTER_BLOCK_SIZE;
+static_assert((RASTER_BLOCK_SIZE & (RASTER_BLOCK_SIZE - 1)) == 0, "Pixel positions inside a block are masked out of coordinates");
+
+constexpr uint32_t CLEAR_COLOR = 0;
+
+// Depth formats
+// Depth is compared as a float key: NDC depth for float formats, the quantized value for unorm ones, which is exact in a float up to 24 bits
+// Hi-Z stores keys too, so a triangle is tested against it with the key of its nearest depth
+template<bool bReversed>
+struct DepthComparison
+{
+	// Key nearer than anything the buffer can hold, start of farthest depth reductions
+	static constexpr float NearestKey = bReversed ? (std::numeric_limits<float>::max)() : 0.f;
+
+	static inline bool IsNearer(const float inKey, const float inOtherKey) { return bReversed ? inKey > inOtherKey : inKey < inOtherKey; }
+	static inline SIMD::Float8 IsNearer(const SIMD::Float8& inKey, const SIMD::Float8& inOtherKey) { return bReversed ? SIMD::CmpGT(inKey, inOtherKey) : SIMD::CmpLT(inKey, inOtherKey); }
+
+	static inline float Farthest(const float A, const float B) { return bReversed ? glm::min(A, B) : glm::max(A, B); }
+	static inline SIMD::Float8 Farthest(const SIMD::Float8& A, const SIMD::Float8& B) { return bReversed ? SIMD::Min(A, B) : SIMD::Max(A, B); }
+	static inline float ReduceFarthest(const SIMD::Float8& inValue) { return bReversed ? SIMD::ReduceMin(inValue) : SIMD::ReduceMax(inValue); }
+};
+
+template<bool bReversed>
+struct FloatDepthFormat : DepthComparison<bReversed>
+{
+	using StorageType = float;
+	// Workaround for windef macro causing compilation issues: https://stackoverflow.com/questions/1394132/macro-and-member-function-conflict
+	static constexpr float ClearKey = bReversed ? 0.f : (std::numeric_limits<float>::max)();
+
+	static inline float ToKey(const float inNDCDepth) { return inNDCDepth; }
+	static inline float Load(const StorageType* inPtr) { return *inPtr; }
+	static inline void Store(StorageType* inPtr, const float inKey) { *inPtr = inKey; }
+
+	static inline SIMD::Float8 ToKey(const SIMD::Float8& inNDCDepth) { return inNDCDepth; }
+	static inline SIMD::Float8 Load8(const StorageType* inPtr) { return SIMD::LoadU(inPtr); }
+	static inline void Store8(StorageType* inPtr, const SIMD::Float8& inKey) { SIMD::StoreU(inPtr, inKey); }
+};
+
+template<typename StorageT, uint32_t MaxValue>
+struct UnormDepthFormat : DepthComparison<false>
+{
+	using StorageType = StorageT;
+	static constexpr float Scale = static_cast<float>(MaxValue);
+	static constexpr float ClearKey = Scale;
+	static_assert(MaxValue <= (1u << 24), "Keys have to be exact in a float");
+
+	// Rounds to nearest, depth is already known to be within [0, 1]
+	// Scalar and SIMD do the same float operations so both paths quantize identically
+	static inline float ToKey(const float inNDCDepth) { return static_cast<float>(static_cast<int32_t>(inNDCDepth * Scale + 0.5f)); }
+	static inline float Load(const StorageType* inPtr) { return static_cast<float>(*inPtr); }
+	static inline void Store(StorageType* inPtr, const float inKey) { *inPtr = static_cast<StorageType>(inKey); }
+
+	static inline SIMD::Float8 ToKey(const SIMD::Float8& inNDCDepth) { return SIMD::ToFloat(SIMD::ToIntTruncate(inNDCDepth * SIMD::Set1(Scale) + SIMD::Set1(0.5f))); }
+	static inline SIMD::Float8 Load8(const StorageType* inPtr) { return SIMD::ToFloat(SIMD::LoadU(inPtr)); }
+	// Lanes that are not written keep a loaded key, so every lane is within the format's range
+	static inline void Store8(StorageType* inPtr, const SIMD::Float8& inKey) { SIMD::StoreU(inPtr, SIMD::ToIntTruncate(inKey)); }
+};
+
+template<EDepthFormat Format>
+struct DepthFormatTraits;
+
+template<> struct DepthFormatTraits<EDepthFormat::Float32> : FloatDepthFormat<false> {};
+template<> struct DepthFormatTraits<EDepthFormat::Unorm16> : UnormDepthFormat<uint16_t, 0xffffu> {};
+template<> struct DepthFormatTraits<EDepthFormat::Unorm24> : UnormDepthFormat<uint32_t, 0xffffffu> {};
+template<> struct DepthFormatTraits<EDepthFormat::Float32ReversedZ> : FloatDepthFormat<true> {};
+
+// Key of a triangle's nearest depth for Hi-Z tests, clamped as it may lie outside of the depth range
+template<typename DepthTraits>
+inline float GetNearestDepthKey(const float inNearestDepth)
+{
+	return DepthTraits::ToKey(glm::clamp(inNearestDepth, 0.f, 1.f));
+}
+
+inline bool IsReversedZ(const EDepthFormat inFormat)
+{
+	return inFormat == EDepthFormat::Float32ReversedZ;
+}
+
+// Color formats
+// Shading outputs RGBA8, which RGBA8 targets store as is
+template<EColorFormat Format>
+struct ColorFormatTraits;
+
+template<>
+struct ColorFormatTraits<EColorFormat::RGBA8>
 {
-public:
-	Barrier(uint32_t inThreshold)
-		: InitialThreshold(inThreshold), NotWaitingCount(inThreshold), Generation(0)
+	using StorageType = uint32_t;
+
+	static inline StorageType Pack(const uint32_t inRGBA) { return inRGBA; }
+	static inline void Store(StorageType* inPtr, const uint32_t inRGBA) { *inPtr = inRGBA; }
+	// Only the lanes set in inWriteBits are written
+	static inline void Store8(StorageType* inPtr, const uint32_t* inRGBA, const uint32_t inWriteBits)
 	{
-		ASSERT(inThreshold != 0);
+		SIMD::StoreU(inPtr, SIMD::Select(SIMD::MaskFromBits(inWriteBits), SIMD::LoadU(inRGBA), SIMD::LoadU(inPtr)));
 	}
+};
+
+// Formats whose channels are separate bit fields, an RGBA8 color is packed as the OR of a table entry per channel
+// Tables are built once from glm's packing, see InitColorPackTable
+template<EColorFormat Format, typename StorageT>
+struct PackedColorFormat
+{
+	using StorageType = StorageT;
 
-	bool Wait()
+	// Packed value of each 8 bit value of each channel, the other channels being 0
+	static inline StorageType PackTable[4][256];
+
+	static inline StorageType Pack(const uint32_t inRGBA)
 	{
-		std::unique_lock lock(Mutex);
-		const uint32_t gen = Generation;
+		return PackTable[0][inRGBA & 0xff] | PackTable[1][(inRGBA >> 8) & 0xff] | PackTable[2][(inRGBA >> 16) & 0xff] | PackTable[3][inRGBA >> 24];
+	}
 
-		if (--NotWaitingCount == 0)
+	static inline void Store(StorageType* inPtr, const uint32_t inRGBA) { *inPtr = Pack(inRGBA); }
+	static inline void Store8(StorageType* inPtr, const uint32_t* inRGBA, const uint32_t inWriteBits)
+	{
+		for (int32_t lane = 0; lane < SIMD::Width; ++lane)
 		{
-			Generation++;
-			NotWaitingCount = InitialThreshold;
-			Condition.notify_all();
-
-			return true;
+			if (inWriteBits & (1u << lane))
+			{
+				inPtr[lane] = Pack(inRGBA[lane]);
+			}
 		}
+	}
+};
+
+// Small floats have an exponent bias of 15, moving their bits to the top of a float's exponent and mantissa and scaling by 2^(127 - 15) rebases them
+// Their denormals come out right too, as float denormals scaled by the same factor
+constexpr float SMALL_FLOAT_EXPONENT_REBASE = 5.192296858534828e33f;
+
+inline SIMD::Float8 SmallFloatToFloat(const SIMD::Int8& inBits, const int32_t inMantissaBits)
+{
+	return SIMD::AsFloat(SIMD::ShiftLeft(inBits, 23 - inMantissaBits)) * SIMD::Set1(SMALL_FLOAT_EXPONENT_REBASE);
+}
 
-		while (gen == Generation)
+template<>
+struct ColorFormatTraits<EColorFormat::RGBA16F> : PackedColorFormat<EColorFormat::RGBA16F, uint64_t>
+{
+	static inline StorageType PackFloat(const glm::vec4& inColor) { return glm::packHalf4x16(inColor); }
+
+	// Channels of 8 pixels, halves are split in 32 bit lanes first
+	static inline void Unpack8(const StorageType* inPtr, SIMD::Float8 outChannels[4])
+	{
+		using namespace SIMD;
+
+		alignas(32) uint32_t halves[4][Width];
+		for (int32_t lane = 0; lane < Width; ++lane)
 		{
-			Condition.wait(lock);
+			for (int32_t channel = 0; channel < 4; ++channel)
+			{
+				halves[channel][lane] = static_cast<uint32_t>(inPtr[lane] >> (channel * 16)) & 0xffffu;
+			}
 		}
 
-		return false;
+		for (int32_t channel = 0; channel < 4; ++channel)
+		{
+			const Int8 bits = LoadU(halves[channel]);
+			const Int8 sign = ShiftLeft(And(bits, Set1Int(0x8000)), 16);
+			outChannels[channel] = Or(SmallFloatToFloat(And(bits, Set1Int(0x7fff)), 10), AsFloat(sign));
+		}
 	}
+};
+
+template<>
+struct ColorFormatTraits<EColorFormat::R11G11B10F> : PackedColorFormat<EColorFormat::R11G11B10F, uint32_t>
+{
+	static inline StorageType PackFloat(const glm::vec4& inColor) { return glm::packF2x11_1x10(glm::vec3(inColor)); }
 
-	void Stop()
+	static inline void Unpack8(const StorageType* inPtr, SIMD::Float8 outChannels[4])
 	{
-		++Generation;
-		Condition.notify_all();
+		using namespace SIMD;
+
+		const Int8 pixels = LoadU(inPtr);
+		outChannels[0] = SmallFloatToFloat(And(pixels, Set1Int(0x7ff)), 6);
+		outChannels[1] = SmallFloatToFloat(And(ShiftRight(pixels, 11), Set1Int(0x7ff)), 6);
+		outChannels[2] = SmallFloatToFloat(ShiftRight(pixels, 22), 5);
+		outChannels[3] = Set1(1.f);
 	}
+};
 
+template<>
+struct ColorFormatTraits<EColorFormat::RGB10A2> : PackedColorFormat<EColorFormat::RGB10A2, uint32_t>
+{
+	static inline StorageType PackFloat(const glm::vec4& inColor) { return glm::packUnorm3x10_1x2(inColor); }
 
-public:
-	std::mutex Mutex;
-	std::condition_variable Condition;
-	const uint32_t InitialThreshold;
-	std::atomic<uint32_t> NotWaitingCount;
-	std::atomic<uint32_t> Generation;
+	static inline void Unpack8(const StorageType* inPtr, SIMD::Float8 outChannels[4])
+	{
+		using namespace SIMD;
+
+		const Int8 pixels = LoadU(inPtr);
+		const Int8 channelMask = Set1Int(0x3ff);
+		outChannels[0] = ToFloat(And(pixels, channelMask)) * Set1(1.f / 1023.f);
+		outChannels[1] = ToFloat(And(ShiftRight(pixels, 10), channelMask)) * Set1(1.f / 1023.f);
+		outChannels[2] = ToFloat(And(ShiftRight(pixels, 20), channelMask)) * Set1(1.f / 1023.f);
+		outChannels[3] = ToFloat(ShiftRight(pixels, 30)) * Set1(1.f / 3.f);
+	}
 };
 
+template<EColorFormat Format>
+void InitColorPackTable()
+{
+	using ColorTraits = ColorFormatTraits<Format>;
 
-constexpr int32_t NUM_THREADS = 8;
-constexpr int32_t PIXEL_QUAD_LENGTH = 2; // Always square, PIXEL_QUAD_LENGTH pixels on X and PIXEL_QUAD_LENGTH pixels on Y
+	for (int32_t channel = 0; channel < 4; ++channel)
+	{
+		for (int32_t value = 0; value < 256; ++value)
+		{
+			glm::vec4 color(0.f);
+			color[channel] = value / 255.f;
+			ColorTraits::PackTable[channel][value] = ColorTraits::PackFloat(color);
+		}
+	}
+}
 
-Barrier s_StartBarrier(NUM_THREADS + 1);
-Barrier s_EndBarrier(NUM_THREADS + 1);
+inline int32_t GetColorFormatBytesPerPixel(const EColorFormat inFormat)
+{
+	return static_cast<int32_t>(inFormat == EColorFormat::RGBA16F ? sizeof(uint64_t) : sizeof(uint32_t));
+}
+
+// Calls inFunction with the format as a std::integral_constant, so that a generic lambda can pick the template instantiation for it
+template<typename FunctionType>
+inline void DispatchDepthFormat(const EDepthFormat inFormat, const FunctionType& inFunction)
+{
+	switch (inFormat)
+	{
+	case EDepthFormat::Unorm16:
+		inFunction(std::integral_constant<EDepthFormat, EDepthFormat::Unorm16>());
+		break;
+	case EDepthFormat::Unorm24:
+		inFunction(std::integral_constant<EDepthFormat, EDepthFormat::Unorm24>());
+		break;
+	case EDepthFormat::Float32ReversedZ:
+		inFunction(std::integral_constant<EDepthFormat, EDepthFormat::Float32ReversedZ>());
+		break;
+	default:
+		inFunction(std::integral_constant<EDepthFormat, EDepthFormat::Float32>());
+		break;
+	}
+}
 
-eastl::vector<std::thread> s_Threads;
+template<typename FunctionType>
+inline void DispatchColorFormat(const EColorFormat inFormat, const FunctionType& inFunction)
+{
+	switch (inFormat)
+	{
+	case EColorFormat::RGBA16F:
+		inFunction(std::integral_constant<EColorFormat, EColorFormat::RGBA16F>());
+		break;
+	case EColorFormat::R11G11B10F:
+		inFunction(std::integral_constant<EColorFormat, EColorFormat::R11G11B10F>());
+		break;
+	case EColorFormat::RGB10A2:
+		inFunction(std::integral_constant<EColorFormat, EColorFormat::RGB10A2>());
+		break;
+	default:
+		inFunction(std::integral_constant<EColorFormat, EColorFormat::RGBA8>());
+		break;
+	}
+}
 
-static PixelShadeDataPkg s_PixelShadeData;
+// Pipeline states, see PipelineStateKey
+// Kernels are templates over a state type, which tells them what is a compile time constant
 
-static int32_t s_StartQuadIdx			= 0;
-static int32_t s_EndQuadIdx				= 0;
+// A permutation compiled with all of its key as constants, FlatColor aside
+template<EDepthFormat InDepthFormat, EColorFormat InColorFormat, uint8_t InFlags, ETextureFilter InTextureFilter = ETextureFilter::BaseLevelPoint, uint16_t InVaryingMask = GetVaryingMask(InFlags)>
+struct TPipelineState
+{
+	static constexpr EDepthFormat DepthFormat = InDepthFormat;
+	static constexpr EColorFormat ColorFormat = InColorFormat;
 
-static int32_t s_pixelMinX				= 0;
-static int32_t s_pixelMinY				= 0;
+	static constexpr bool HasFlag(const PipelineStateKey&, const uint8_t inFlag) { return (InFlags & inFlag) != 0; }
+	static constexpr ETextureFilter GetTextureFilter(const PipelineStateKey&) { return InTextureFilter; }
+	static constexpr int32_t GetVaryingPlaneIdx(const PipelineStateKey&, const int32_t inSlot) { return ::GetVaryingPlaneIdx(InVaryingMask, inSlot); }
 
-static int32_t s_pixelMaxX				= 0;
-static int32_t s_pixelMaxY				= 0;
+	static bool Matches(const PipelineStateKey& inKey)
+	{
+		return inKey.DepthFormat == InDepthFormat && inKey.ColorFormat == InColorFormat && inKey.Flags == InFlags && inKey.TextureFilter == InTextureFilter && inKey.VaryingMask == InVaryingMask;
+	}
+};
 
-static int32_t s_NumQuadsPerImageRow	= 0;
-static int32_t s_NumTotalQuadsPerScreen	= 0;
-static int32_t s_NumTotalQuadsCurrRun	= 0;
+// Fallback for keys that are not compiled permutations, only the formats are constants and flags are read from the key
+template<EDepthFormat InDepthFormat, EColorFormat InColorFormat>
+struct TGenericPipelineState
+{
+	static constexpr EDepthFormat DepthFormat = InDepthFormat;
+	static constexpr EColorFormat ColorFormat = InColorFormat;
 
-std::atomic<int32_t> s_CurrAvailableQuad = ATOMIC_VAR_INIT(0);
-std::atomic<bool> s_Paused = ATOMIC_VAR_INIT(false);
+	static inline bool HasFlag(const PipelineStateKey& inKey, const uint8_t inFlag) { return (inKey.Flags & inFlag) != 0; }
+	static inline ETextureFilter GetTextureFilter(const PipelineStateKey& inKey) { return inKey.TextureFilter; }
+	static inline int32_t GetVaryingPlaneIdx(const PipelineStateKey& inKey, const int32_t inSlot) { return ::GetVaryingPlaneIdx(inKey.VaryingMask, inSlot); }
+};
 
-void ShadingThreadRun(SoftwareRasterizer* inRasterizer)
+template<typename... States>
+struct TPipelineStateList {};
+
+// Every permutation is a full copy of the raster and shade code, so only the states actually drawn with are here
+// Default formats get the common variations, other formats only the default textured state
+using CompiledPipelineStates = TPipelineStateList<
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA8, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA8, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::NearestMipPoint>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA8, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::BaseLevelPoint>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA8, Ps_DepthTest | Ps_ColorWrite>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA8, Ps_DepthTest | Ps_LateZ | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA8, Ps_DepthTest | Ps_VisibilityBuffer | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA8, Ps_DepthTest | Ps_VisibilityBuffer | Ps_ColorWrite>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA8, Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Unorm16, EColorFormat::RGBA8, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Unorm24, EColorFormat::RGBA8, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Float32ReversedZ, EColorFormat::RGBA8, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGBA16F, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::R11G11B10F, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Float32, EColorFormat::RGB10A2, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>,
+	TPipelineState<EDepthFormat::Float32ReversedZ, EColorFormat::RGBA16F, Ps_DepthTest | Ps_Textured | Ps_ColorWrite, ETextureFilter::Trilinear>
+>;
+
+// Calls inFunction with the compiled permutation matching the key, or with the generic state of its formats if there is none, in which case it returns false
+template<typename FunctionType, typename... States>
+inline bool DispatchPipelineState(const PipelineStateKey& inKey, TPipelineStateList<States...>, const FunctionType& inFunction)
 {
-	while (GEngine->IsRunning())
+	if ((... || (States::Matches(inKey) && (inFunction(States()), true))))
 	{
-		s_StartBarrier.Wait();
+		return true;
+	}
 
-		while (true)
+	DispatchDepthFormat(inKey.DepthFormat, [&inKey, &inFunction](auto inDepthFormat)
 		{
-			const int32_t currAvailableQuad = s_CurrAvailableQuad.fetch_add(1);
-			const bool isCurrQuadValid = currAvailableQuad >= 0 && currAvailableQuad <= s_NumTotalQuadsPerScreen && currAvailableQuad >= s_StartQuadIdx && currAvailableQuad <= s_EndQuadIdx;
+			using DepthFormatConstant = decltype(inDepthFormat);
+			DispatchColorFormat(inKey.ColorFormat, [&inFunction](auto inColorFormat)
+				{
+					inFunction(TGenericPipelineState<DepthFormatConstant::value, decltype(inColorFormat)::value>());
+				});
+		});
 
-			if (!isCurrQuadValid || !GEngine->IsRunning() || s_Paused.load())
-			{
-				break;
-			}
-			else
-			{
-				const int32_t currGroupY = currAvailableQuad / s_NumQuadsPerImageRow;
-				const int32_t currGroupX = currAvailableQuad % s_NumQuadsPerImageRow;
+	return false;
+}
 
-				// Execute quads horizontally
-				for (int32_t pixelGroupIdxY = 0; pixelGroupIdxY < PIXEL_QUAD_LENGTH; ++pixelGroupIdxY)
-				{
-					for (int32_t pixelGroupIdxX = 0; pixelGroupIdxX < PIXEL_QUAD_LENGTH; ++pixelGroupIdxX)
-					{
-						int32_t pixelPosX = s_pixelMinX + (currGroupX * PIXEL_QUAD_LENGTH) + pixelGroupIdxX;
-						pixelPosX = glm::clamp(pixelPosX, s_pixelMinX, s_pixelMaxX);
+// Texture sampling
+// Textures are 4 bytes per texel, sampled from their swizzled copy, see SwizzledTexture
 
-						int32_t pixelPosY = s_pixelMinY + (currGroupY * PIXEL_QUAD_LENGTH) + pixelGroupIdxY;
-						pixelPosY = glm::clamp(pixelPosY, s_pixelMinY, s_pixelMaxY);
+// Varying planes the texcoords of a triangle are interpolated from, texture LOD is computed from them
+struct TexCoordPlanes
+{
+	const ScreenPlane* OneOverW = nullptr;
+	const ScreenPlane* UOverW = nullptr;
+	const ScreenPlane* VOverW = nullptr;
+};
 
-						inRasterizer->ShadePixel(pixelPosX, pixelPosY, s_PixelShadeData);
-					}
+// LOD of the 2x2 quad the pixel is in, from the texcoord differences between the quad's first pixel and its right and lower neighbours
+// Every pixel of a quad gets the same LOD, like coarse derivatives on GPUs
+inline float ComputeQuadTextureLOD(const PixelShadeDataPkg& inPixelData, const TexCoordPlanes& inPlanes, const int32_t inX, const int32_t inY)
+{
+	const float quadX = static_cast<float>(inX - inX % PIXEL_QUAD_LENGTH - inPixelData.PixelMinX);
+	const float quadY = static_cast<float>(inY - inY % PIXEL_QUAD_LENGTH - inPixelData.PixelMinY);
+
+	const ScreenPlane& uOverWPlane = *inPlanes.UOverW;
+	const ScreenPlane& vOverWPlane = *inPlanes.VOverW;
+	const ScreenPlane& oneOverWPlane = *inPlanes.OneOverW;
+	const float uOverW = uOverWPlane.Evaluate(quadX, quadY);
+	const float vOverW = vOverWPlane.Evaluate(quadX, quadY);
+	const float oneOverW = oneOverWPlane.Evaluate(quadX, quadY);
+
+	const glm::vec2 texCoords = glm::vec2(uOverW, vOverW) / oneOverW;
+	const glm::vec2 texCoordsRight = glm::vec2(uOverW + uOverWPlane.DDX, vOverW + vOverWPlane.DDX) / (oneOverW + oneOverWPlane.DDX);
+	const glm::vec2 texCoordsDown = glm::vec2(uOverW + uOverWPlane.DDY, vOverW + vOverWPlane.DDY) / (oneOverW + oneOverWPlane.DDY);
+
+	const SwizzledMip& baseLevel = inPixelData.Texture->GetMip(0);
+	const glm::vec2 textureSize(static_cast<float>(baseLevel.Width), static_cast<float>(baseLevel.Height));
+	const glm::vec2 texelsDX = (texCoordsRight - texCoords) * textureSize;
+	const glm::vec2 texelsDY = (texCoordsDown - texCoords) * textureSize;
+
+	// log2 of the longest footprint side, halved as it is taken on the squared length
+	return 0.5f * std::log2(glm::max(glm::dot(texelsDX, texelsDX), glm::dot(texelsDY, texelsDY)));
+}
 
-				}
-			}
-		}
+// Address mode of every filter and mip, texels past an edge wrap around to the opposite one as with tiled texcoords
+// so bilinear taps along the edges blend with the other side instead of repeating the edge texels
+inline int32_t WrapTexel(const int32_t inTexel, const int32_t inSize)
+{
+	const int32_t wrapped = inTexel % inSize;
 
-		s_EndBarrier.Wait();
-	}
+	return wrapped < 0 ? wrapped + inSize : wrapped;
 }
 
-void SoftwareRasterizer::Init(const int32_t inImageWidth, const int32_t inImageHeight)
+inline uint32_t SamplePoint(const SwizzledMip& inMip, const glm::vec2& inTexCoords)
 {
-	ImageWidth = inImageWidth;
-	ImageHeight = inImageHeight;
+	const int32_t x = WrapTexel(static_cast<int32_t>(std::floor(inTexCoords.x * inMip.Width)), inMip.Width);
+	const int32_t y = WrapTexel(static_cast<int32_t>(std::floor(inTexCoords.y * inMip.Height)), inMip.Height);
 
-	IntermediaryImageData = new glm::vec4[inImageWidth * inImageHeight];
-	FinalImageData = new uint32_t[inImageWidth * inImageHeight];
-	DepthData = new float[inImageWidth * inImageHeight];
+	return inMip.Fetch(x, y);
+}
 
-	ClearImageBuffers();
+inline glm::vec4 UnpackRGBA(const uint32_t inRGBA)
+{
+	return glm::vec4(static_cast<float>(inRGBA & 0xff), static_cast<float>((inRGBA >> 8) & 0xff), static_cast<float>((inRGBA >> 16) & 0xff), static_cast<float>(inRGBA >> 24));
+}
+
+// Channels in [0, 255]
+inline glm::vec4 SampleBilinear(const SwizzledMip& inMip, const glm::vec2& inTexCoords)
+{
+	const int32_t width = inMip.Width;
+	const int32_t height = inMip.Height;
+
+	// Texel centers are at half texels, see WrapTexel for the edges
+	const float x = inTexCoords.x * width - 0.5f;
+	const float y = inTexCoords.y * height - 0.5f;
+	const float floorX = std::floor(x);
+	const float floorY = std::floor(y);
+	const int32_t x0 = WrapTexel(static_cast<int32_t>(floorX), width);
+	const int32_t y0 = WrapTexel(static_cast<int32_t>(floorY), height);
+	const int32_t x1 = WrapTexel(static_cast<int32_t>(floorX) + 1, width);
+	const int32_t y1 = WrapTexel(static_cast<int32_t>(floorY) + 1, height);
+
+	const glm::vec4 top = glm::mix(UnpackRGBA(inMip.Fetch(x0, y0)), UnpackRGBA(inMip.Fetch(x1, y0)), x - floorX);
+	const glm::vec4 bottom = glm::mix(UnpackRGBA(inMip.Fetch(x0, y1)), UnpackRGBA(inMip.Fetch(x1, y1)), x - floorX);
+
+	return glm::mix(top, bottom, y - floorY);
+}
 
-	const int32_t numQuadsY = (inImageHeight / PIXEL_QUAD_LENGTH) + glm::min(PIXEL_QUAD_LENGTH - 1, inImageHeight % PIXEL_QUAD_LENGTH);
-	s_NumQuadsPerImageRow = (inImageWidth / PIXEL_QUAD_LENGTH) + glm::min(PIXEL_QUAD_LENGTH - 1, inImageWidth % PIXEL_QUAD_LENGTH);
-	s_NumTotalQuadsPerScreen = numQuadsY * s_NumQuadsPerImageRow;
-	//NumTotalQuads = 1;
+// Returns false if the fragment is discarded
+// Texcoords outside of [0, 1) are discarded the same way whatever the filter is, NaN included
+inline bool SampleTexture(const PixelShadeDataPkg& inPixelData, const TexCoordPlanes& inPlanes, const glm::vec2& inTexCoords, const ETextureFilter inFilter, const int32_t inX, const int32_t inY, uint32_t& outRGBA)
+{
+	if (!(inTexCoords.x >= 0.f && inTexCoords.x < 1.f && inTexCoords.y >= 0.f && inTexCoords.y < 1.f))
+	{
+		return false;
+	}
 
-	static int const max = std::thread::hardware_concurrency();
-	for (int32_t threadIdx = 0; threadIdx < NUM_THREADS; ++threadIdx)
+	const SwizzledTexture& texture = *inPixelData.Texture;
+	if (inFilter == ETextureFilter::BaseLevelPoint)
 	{
-		std::thread newThread = std::thread(ShadingThreadRun, this);
+		outRGBA = SamplePoint(texture.GetMip(0), inTexCoords);
+		return true;
+	}
+
+	// Also catches NaN from degenerate derivatives, magnification uses the base level
+	const float maxLOD = static_cast<float>(texture.GetNumMips() - 1);
+	float lod = ComputeQuadTextureLOD(inPixelData, inPlanes, inX, inY);
+	lod = lod > 0.f ? glm::min(lod, maxLOD) : 0.f;
 
-		eastl::wstring threadName = L"Software Rasterizer Thread ";
-		threadName += eastl::to_wstring(threadIdx);
+	if (inFilter == ETextureFilter::NearestMipPoint)
+	{
+		outRGBA = SamplePoint(texture.GetMip(static_cast<int32_t>(lod + 0.5f)), inTexCoords);
+		return true;
+	}
 
-		SetThreadDescription(newThread.native_handle(), threadName.c_str());
+	const int32_t level = static_cast<int32_t>(lod);
+	const float levelFraction = lod - level;
 
-		s_Threads.push_back(std::move(newThread));
+	glm::vec4 color = SampleBilinear(texture.GetMip(level), inTexCoords);
+	if (levelFraction > 0.f)
+	{
+		color = glm::mix(color, SampleBilinear(texture.GetMip(level + 1), inTexCoords), levelFraction);
 	}
 
-	s_Paused.store(true);
+	const glm::uvec4 rounded = glm::uvec4(color + 0.5f);
+	outRGBA = (rounded.a << 24) | (rounded.b << 16) | (rounded.g << 8) | rounded.r;
+
+	return true;
 }
 
-SoftwareRasterizer::~SoftwareRasterizer()
+template<typename State>
+inline TexCoordPlanes GetTexCoordPlanes(const eastl::vector<ScreenPlane>& inVaryingPlanes, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey)
 {
-	// Shut down threads
-	s_Paused.store(true);
-	s_StartBarrier.Stop();
-	s_EndBarrier.Stop();
+	const ScreenPlane* planes = &inVaryingPlanes[inPixelData.FirstVaryingPlane];
 
-	for (std::thread& t : s_Threads)
-	{
-		t.join();
-	}
+	TexCoordPlanes texCoordPlanes;
+	texCoordPlanes.OneOverW = planes;
+	texCoordPlanes.UOverW = &planes[State::GetVaryingPlaneIdx(inKey, Varying_TexCoordU)];
+	texCoordPlanes.VOverW = &planes[State::GetVaryingPlaneIdx(inKey, Varying_TexCoordV)];
 
-	delete IntermediaryImageData;
-	delete FinalImageData;
+	return texCoordPlanes;
 }
+// Resolve
+// sRGB encoding of 8 bit channels, in 8.8 fixed point so that the fraction can be rounded or dithered away
+static uint32_t s_SRGBEncodeLUT[256];
+
+// Same for float formats, from linear values quantized to 12 bits so that dark values keep more than 8 bits of steps
+constexpr int32_t SRGB_ENCODE_WIDE_LUT_MAX = (1 << 12) - 1;
+static uint32_t s_SRGBEncodeWideLUT[SRGB_ENCODE_WIDE_LUT_MAX + 1];
 
-void SoftwareRasterizer::TransposeImage()
+static uint32_t EncodeSRGBFixedPoint(const float inLinear)
 {
-	for (int32_t i = 0; i < ImageHeight / 2; ++i)
-	{
-		char* swap1 = (char*)&FinalImageData[i * ImageWidth];
-		char* swap1End = (char*)&FinalImageData[i * ImageWidth + ImageWidth];// End of line
-		//--swap1End;// Go back 1 character to end of line
+	const float encoded = inLinear <= 0.0031308f ? inLinear * 12.92f : 1.055f * powf(inLinear, 1.f / 2.4f) - 0.055f;
+
+	// At most 255.0, so adding a rounding or dither offset below 1.0 never overflows 8 bits
+	return static_cast<uint32_t>(glm::clamp(encoded, 0.f, 1.f) * 255.f * 256.f + 0.5f);
+}
 
-		char* swap2 = (char*)&FinalImageData[(ImageHeight - 1 - i) * ImageWidth];
+static void InitSRGBEncodeLUT()
+{
+	for (int32_t value = 0; value < 256; ++value)
+	{
+		s_SRGBEncodeLUT[value] = EncodeSRGBFixedPoint(value / 255.f);
+	}
 
-		std::swap_ranges((char*)swap1, swap1End, swap2);
+	for (int32_t value = 0; value <= SRGB_ENCODE_WIDE_LUT_MAX; ++value)
+	{
+		s_SRGBEncodeWideLUT[value] = EncodeSRGBFixedPoint(static_cast<float>(value) / SRGB_ENCODE_WIDE_LUT_MAX);
 	}
 }
 
-const float CAMERA_FOV = 45.f;
-const float CAMERA_NEAR = 0.1f;
-const float CAMERA_FAR = 100.f;
+// 4x4 ordered dither offsets in 8.8 fixed point, centered in each step so that they average to the 0.5 of rounding
+// A row repeats every 4 pixels, so the 4 pixel row is laid out twice to cover a SIMD batch
+static constexpr uint32_t DITHER_ROWS[4][SIMD::Width] =
+{
+	{   8, 136,  40, 168,   8, 136,  40, 168 },
+	{ 200,  72, 232, 104, 200,  72, 232, 104 },
+	{  56, 184,  24, 152,  56, 184,  24, 152 },
+	{ 248, 120, 216,  88, 248, 120, 216,  88 }
+};
 
-inline glm::vec4 TransformPosition(const glm::vec3& inVtx, const glm::mat4& inMat)
+// Encodes the color channels of 8 RGBA8 pixels to sRGB, alpha stays linear
+inline SIMD::Int8 EncodeSRGB(const SIMD::Int8& inPixels, const SIMD::Int8& inRoundOffsets)
 {
-	glm::vec4 vtxTransformed = inMat * glm::vec4(inVtx.x, inVtx.y, inVtx.z, 1.f);
+	using namespace SIMD;
 
-	return vtxTransformed;
+	const Int8 channelMask = Set1Int(0xff);
+	Int8 result = And(inPixels, Set1Int(static_cast<int32_t>(0xff000000u)));
+	for (const int32_t channelShift : { 0, 8, 16 })
+	{
+		const Int8 channel = And(ShiftRight(inPixels, channelShift), channelMask);
+		const Int8 encoded = ShiftRight(Gather(s_SRGBEncodeLUT, channel) + inRoundOffsets, 8);
+		result = Or(result, ShiftLeft(encoded, channelShift));
+	}
+
+	return result;
 }
 
-inline glm::vec3 HomDivide(const glm::vec4& inHomCoordinates)
+// Quantizes a channel to 8 bits, clamped to [0, 1] first, NaN included
+inline SIMD::Int8 QuantizeChannel(const SIMD::Float8& inValue, const SIMD::Int8& inRoundOffsets, const bool inEncodeSRGB)
 {
-	glm::vec3 out = glm::vec3(inHomCoordinates);
-	const float hommCoordinate = inHomCoordinates.w;
-	// Persp divide
-	// Can give divide by 0 when vtx is on near plane as dist is 0 then
-	if (hommCoordinate != 0)
+	using namespace SIMD;
+
+	const Float8 clamped = Min(Max(inValue, Set1(0.f)), Set1(1.f));
+	if (inEncodeSRGB)
 	{
-		out /= hommCoordinate;
+		const Int8 index = ToIntTruncate(clamped * Set1(static_cast<float>(SRGB_ENCODE_WIDE_LUT_MAX)) + Set1(0.5f));
+		return ShiftRight(Gather(s_SRGBEncodeWideLUT, index) + inRoundOffsets, 8);
 	}
 
-	return out;
+	return ShiftRight(ToIntTruncate(clamped * Set1(255.f * 256.f)) + inRoundOffsets, 8);
 }
 
-void SoftwareRasterizer::DrawModelWireframe(const eastl::shared_ptr<Model3D>& inModel)
+// Converts 8 consecutive pixels of a color target to RGBA8
+template<EColorFormat Format>
+inline SIMD::Int8 ResolvePixels(const typename ColorFormatTraits<Format>::StorageType* inPixels, const SIMD::Int8& inRoundOffsets, const bool inEncodeSRGB)
 {
-	static int32_t maxLines = 128;
-	static int32_t maxTriangles = 32;
+	using namespace SIMD;
 
+	Float8 channels[4];
+	ColorFormatTraits<Format>::Unpack8(inPixels, channels);
+
+	Int8 result = ShiftLeft(QuantizeChannel(channels[3], inRoundOffsets, false), 24);
+	for (int32_t channel = 0; channel < 3; ++channel)
 	{
-		ImGui::Begin("Software Rasterizer");
-		ImGui::SliderInt("Lines to draw", &maxLines, 0, 128);
-		ImGui::SliderInt("Triangles to draw", &maxTriangles, 0, 32);
-		ImGui::End();
+		result = Or(result, ShiftLeft(QuantizeChannel(channels[channel], inRoundOffsets, inEncodeSRGB), channel * 8));
 	}
 
-	int32_t countLines = 0;
-	int32_t countTriangles = 0;
+	return result;
+}
 
-	const eastl::vector<TransformObjPtr>& modelChildren = inModel->GetChildren();
+// Already RGBA8, a plain copy unless encoded
+template<>
+inline SIMD::Int8 ResolvePixels<EColorFormat::RGBA8>(const uint32_t* inPixels, const SIMD::Int8& inRoundOffsets, const bool inEncodeSRGB)
+{
+	const SIMD::Int8 pixels = SIMD::LoadU(inPixels);
 
-	const Transform& modelTrans = inModel->GetAbsoluteTransform();
-	const glm::mat4 absoluteMat = modelTrans.GetMatrix();
-	//const glm::mat4 projection = glm::orthoLH_ZO(-20.f, 20.f, -20.f, 20.f, 0.f, 20.f);
-	const glm::mat4 projection = glm::perspectiveLH_ZO(glm::radians(CAMERA_FOV), static_cast<float>(ImageWidth) / static_cast<float>(ImageHeight), CAMERA_NEAR, CAMERA_FAR);
-	// Object needs to be at + or - 120 to be drawn, why?
+	return inEncodeSRGB ? EncodeSRGB(pixels, inRoundOffsets) : pixels;
+}
 
-	for (uint32_t i = 0; i < modelChildren.size(); ++i)
-	{
-		const TransformObjPtr& currChild = modelChildren[i];
-		eastl::shared_ptr<MeshNode> node = eastl::dynamic_shared_pointer_cast<MeshNode>(currChild);
-		if (node)
-		{
-			const eastl::vector<SimpleVertex> CPUVertices = node->CPUVertices;
-			const eastl::vector<uint32_t> CPUIndices = node->CPUIndices;
+void SoftwareRasterizer::Init(const int32_t inImageWidth, const int32_t inImageHeight)
+{
+	ImageWidth = inImageWidth;
+	ImageHeight = inImageHeight;
+	NumBlocksX = (inImageWidth + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+	NumBlocksY = (inImageHeight + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
 
-			const uint32_t numIndices = static_cast<uint32_t>(CPUIndices.size());
-			ASSERT(numIndices % 3 == 0);
-			const uint32_t numTriangles = numIndices / 3;
+	FinalImageData = new uint32_t[inImageWidth * inImageHeight];
 
-			// Draw triangle by triangle
-			for (uint32_t triangleIdx = 0; triangleIdx < numTriangles; ++triangleIdx)
-			{
-				if (countTriangles >= maxTriangles)
-				{
-					return;
-				}
+	HiZWidth = NumBlocksX;
+	HiZHeight = NumBlocksY;
+	HiZData = new float[HiZWidth * HiZHeight];
 
-				const uint32_t idxStart = triangleIdx * 3;
+	OcclusionCuller.Init(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
 
-				// Backface cull
-				{
-					const glm::vec3 v0 = CPUVertices[CPUIndices[idxStart]].Position;
-					const glm::vec3 v1 = CPUVertices[CPUIndices[idxStart + 1]].Position;
-					const glm::vec3 v2 = CPUVertices[CPUIndices[idxStart + 2]].Position;
+	NumTilesX = (inImageWidth + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+	NumTilesY = (inImageHeight + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+	NumTotalTiles = NumTilesX * NumTilesY;
+	TileBins.resize(NumTotalTiles);
+	TileCleared.resize(NumTotalTiles);
 
-					const glm::vec3 v0v1 = v1 - v0;
-					const glm::vec3 v0v2 = v2 - v0;
+	InitSRGBEncodeLUT();
+	InitColorPackTable<EColorFormat::RGBA16F>();
+	InitColorPackTable<EColorFormat::R11G11B10F>();
+	InitColorPackTable<EColorFormat::RGB10A2>();
 
-					// LH CCW culling
-					const glm::vec3 trianglePlaneNormal = glm::normalize(glm::cross(v0v1, v0v2));
-					const glm::vec3 viewDir = glm::vec3(0.f, 0.f, 1.f);
+	AllocateRenderTargets();
+	ClearImageBuffers();
+}
 
-					const float dot = glm::dot(trianglePlaneNormal, viewDir);
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+	StopRenderThread();
 
-					if (dot < 0.f)
-					{
-						// Skip triangle
-						continue;
-					}
-				}
+	delete[] FinalImageData;
+	delete[] HiZData;
+}
 
-				for (uint32_t j = 0; j < 3; ++j)
-				{
-					if (countLines >= maxLines)
-					{
-						return;
-					}
-					const uint32_t currIndex = CPUIndices[idxStart + j];
-					const uint32_t nextIndexIndex = j == 2 ? idxStart : (idxStart + j + 1);
-					const uint32_t nextIndex = CPUIndices[nextIndexIndex];
+void SoftwareRasterizer::AllocateRenderTargets()
+{
+	const int32_t numTargetPixels = NumBlocksX * NumBlocksY * RASTER_BLOCK_PIXELS;
+
+	// Only the color target drawn into, the presented one might still be read by the main thread
+	ColorTargets[CurrentColorBuffer].Allocate({ numTargetPixels, GetColorFormatBytesPerPixel(ColorTargetFormat) });
+	ColorTargetFormats[CurrentColorBuffer] = ColorTargetFormat;
+	ColorTarget = ColorTargets[CurrentColorBuffer].GetData();
 
-					const glm::vec3 currVtx = CPUVertices[currIndex].Position;
-					const glm::vec3 nextVtx = CPUVertices[nextIndex].Position;
+	if (bDepthTestEnabled)
+	{
+		DispatchDepthFormat(DepthFormat, [this, numTargetPixels](auto inFormat)
+			{
+				DepthTarget.Allocate({ numTargetPixels, static_cast<int32_t>(sizeof(typename DepthFormatTraits<decltype(inFormat)::value>::StorageType)) });
+			});
+	}
+	else
+	{
+		DepthTarget.Release();
+	}
+	DepthData = DepthTarget.GetData();
 
-					glm::vec3 currTranfsVtx = HomDivide(TransformPosition(currVtx, projection * absoluteMat));
-					glm::vec3 nextTranfsVtx = HomDivide(TransformPosition(nextVtx, projection * absoluteMat));
+	if (bVisibilityBufferEnabled)
+	{
+		VisibilityTarget.Allocate({ numTargetPixels, static_cast<int32_t>(sizeof(uint32_t)) });
+	}
+	else
+	{
+		VisibilityTarget.Release();
+	}
+	VisibilityData = reinterpret_cast<uint32_t*>(VisibilityTarget.GetData());
+}
 
-					// Re-map from -1..1 to 0..1
-					const glm::vec3 remappedCurrVtx = (currTranfsVtx + 1.f) / 2.f;
-					const glm::vec3 remappedNextVtx = (nextTranfsVtx + 1.f) / 2.f;
+const float CAMERA_FOV = 45.f;
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.f;
 
-					// TODO: Barycentric coordinates to get interpolate between vertex z and write to z buffer(to use for culling) and also remove if behind camera
+inline glm::vec4 TransformPosition(const glm::vec3& inVtx, const glm::mat4& inMat)
+{
+	glm::vec4 vtxTransformed = inMat * glm::vec4(inVtx.x, inVtx.y, inVtx.z, 1.f);
 
-					// Re-map to pixel space
-					const glm::vec2i start(remappedCurrVtx.x * (ImageWidth - 1), remappedCurrVtx.y * (ImageHeight - 1));
-					const glm::vec2i end(remappedNextVtx.x * (ImageWidth - 1), remappedNextVtx.y * (ImageHeight - 1));
+	return vtxTransformed;
+}
 
-					DrawLine(start, end);
-					++countLines;
-				}
+inline glm::vec3 HomDivide(const glm::vec4& inHomCoordinates)
+{
+	glm::vec3 out = glm::vec3(inHomCoordinates);
+	const float hommCoordinate = inHomCoordinates.w;
+	// Persp divide
+	// Can give divide by 0 when vtx is on near plane as dist is 0 then
+	if (hommCoordinate != 0)
+	{
+		out /= hommCoordinate;
+	}
 
-				++countTriangles;
-			}
-		}
+	return out;
+}
 
+// Winding is the one seen on the presented image, where y goes down, while the signed area is computed with y up
+// so positive areas are clockwise on screen
+inline bool IsCulledByWinding(const float inSignedArea, const ETriangleCullMode inCullMode)
+{
+	switch (inCullMode)
+	{
+	case ETriangleCullMode::CW:
+		return inSignedArea > 0.f;
+	case ETriangleCullMode::CCW:
+		return inSignedArea < 0.f;
+	default:
+		return false;
 	}
+}
+
+// Rounds a pixel space position to the nearest point of the sub-pixel grid
+inline glm::vec2i SnapToSubpixel(const glm::vec2& inPixelSpacePos)
+{
+	const glm::vec2 scaled = glm::round(inPixelSpacePos * static_cast<float>(SUBPIXEL_SCALE));
 
+	return glm::vec2i(static_cast<int32_t>(scaled.x), static_cast<int32_t>(scaled.y));
 }
 
 void SoftwareRasterizer::DrawLine(const glm::vec2i& inStart, const glm::vec2i& inEnd, const glm::vec4& inColor)
@@ -373,7 +774,8 @@ void SoftwareRasterizer::DrawLine(const glm::vec2i& inStart, const glm::vec2i& i
 		int32_t pixelPos = 0;
 		if (TryGetPixelPos(x, y, pixelPos))
 		{
-			FinalImageData[pixelPos] = ConvertToRGBA(inColor);
+			InitializeClearedTileAt(x, y);
+			WriteColor(pixelPos, ConvertToRGBA(inColor));
 		}
 
 		//LOG_INFO("Writing to x: %d and y: %d", x, y);
@@ -400,6 +802,12 @@ void SoftwareRasterizer::DrawRandom()
 	const glm::vec4 ColorRed = glm::vec4(1.f, 0.f, 0.f, 1.f);
 	const glm::vec4 ColorBlue = glm::vec4(0.f, 0.f, 1.f, 1.f);
 
+	// Every pixel gets overwritten, only the flags have to be settled
+	for (int32_t tileIdx = 0; tileIdx < NumTotalTiles; ++tileIdx)
+	{
+		InitializeClearedTile(tileIdx);
+	}
+
 	const float stepSize = float(ImageHeight) / 5;
 	for (int32_t i = 0; i < ImageHeight; ++i)
 	{
@@ -410,16 +818,10 @@ void SoftwareRasterizer::DrawRandom()
 			//const bool bIsRed = (i+j) % 2 == 0;
 
 			//const bool bIsRed = i < 200 && j < 200;
-			glm::vec4& currentPixel = IntermediaryImageData[i * ImageWidth + j];
-			glm::vec3 random = randomVec3();
-			currentPixel.x = random.x;
-			currentPixel.y = random.y;
-			currentPixel.z = random.z;
-			currentPixel.a = 1;
+			glm::vec4 currentPixel = glm::vec4(randomVec3(), 1.f);
 			//currentPixel = bIsRed ? ColorRed : ColorBlue;
 
-
-			FinalImageData[i * ImageWidth + j] = ConvertToRGBA(currentPixel);
+			WriteColor(GetPixelPos(j, i), ConvertToRGBA(currentPixel));
 		}
 	}
 }
@@ -431,341 +833,1763 @@ uint32_t* SoftwareRasterizer::GetImage()
 
 void SoftwareRasterizer::PrepareBeforePresent()
 {
-	// y goes down in D3D
-	TransposeImage();
+	FinishFrame();
+
+	ResolveImage(CurrentColorBuffer, reinterpret_cast<uint8_t*>(FinalImageData), ImageWidth * sizeof(uint32_t));
+
+	PresentedStats = Stats;
+}
+
+void SoftwareRasterizer::FinishFrame()
+{
+	RasterizeBinnedTriangles();
+
+	// The color target is complete after this, resolving it does not depend on any per frame state
+	DispatchColorFormat(ColorTargetFormat, [this](auto inColorFormat)
+		{
+			ResolveClearedTiles<decltype(inColorFormat)::value>();
+		});
 }
 
-int32_t maxTriangles = 128;
 bool bDrawTriangleWireframe = false;
 bool bDrawOnlyBackfaceCulled = false;
 bool bUseZBuffer = true;
-
-void SoftwareRasterizer::BeginFrame()
+bool bUseReferenceRasterizer = false;
+bool bUseSIMDRasterizer = true;
+bool bUseVisibilityBuffer = false;
+bool bUseOcclusionCulling = false;
+int32_t occluderCount = 8;
+int32_t depthFormat = static_cast<int32_t>(EDepthFormat::Float32);
+int32_t colorFormat = static_cast<int32_t>(EColorFormat::RGBA8);
+int32_t textureFilter = static_cast<int32_t>(ETextureFilter::Trilinear);
+bool bUseTileAffinity = true;
+bool bResolveSRGB = false;
+bool bResolveDither = true;
+
+// Main thread, the debug UI's settings for the next frame
+static SoftwareRasterizerSettings GetDebugUISettings()
 {
-	// ImGui
-	{
-		ImGui::Begin("Software Rasterizer");
-		ImGui::SliderInt("Triangles to draw", &maxTriangles, 0, 32);
-		ImGui::Checkbox("Draw Triangle Wireframe", &bDrawTriangleWireframe);
-		ImGui::Checkbox("Draw Only Backface culled", &bDrawOnlyBackfaceCulled);
-		ImGui::Checkbox("Use Z-Buffer", &bUseZBuffer);
-		ImGui::End();
-	}
-
-	ClearImageBuffers();
+	SoftwareRasterizerSettings settings;
+	settings.DepthFormat = static_cast<EDepthFormat>(depthFormat);
+	settings.ColorFormat = static_cast<EColorFormat>(colorFormat);
+	settings.TextureFilter = static_cast<ETextureFilter>(textureFilter);
+	settings.bDepthTest = bUseZBuffer;
+	settings.bVisibilityBuffer = bUseVisibilityBuffer;
+	settings.bKeepTileAffinity = bUseTileAffinity;
+	settings.bShowCulledTriangles = bDrawOnlyBackfaceCulled;
+	settings.bDrawWireframe = bDrawTriangleWireframe;
+	settings.bUseReferenceRasterizer = bUseReferenceRasterizer;
+	settings.bUseSIMDRasterizer = bUseSIMDRasterizer;
+	settings.bUseOcclusionCulling = bUseOcclusionCulling;
+	settings.NumOccluders = occluderCount;
+
+	return settings;
 }
 
-void SoftwareRasterizer::ClearImageBuffers()
+static void GatherMeshNodeSnapshots(const eastl::vector<TransformObjPtr>& inChildren, const eastl::vector<MeshMaterial>& inMaterials, eastl::vector<MeshNodeSnapshot>& outNodes)
 {
-	memset(FinalImageData, 0, ImageWidth * ImageHeight * 4);
-	// Workaround for windef macro causing compilation issues: https://stackoverflow.com/questions/1394132/macro-and-member-function-conflict
-	constexpr float maxDepth = (std::numeric_limits<float>::max)();
-	for (int32_t i = 0; i < ImageWidth * ImageHeight; ++i)
+	for (const TransformObjPtr& currChild : inChildren)
 	{
-		DepthData[i] = maxDepth;
+		GatherMeshNodeSnapshots(currChild->GetChildren(), inMaterials, outNodes);
+
+		eastl::shared_ptr<MeshNode> node = eastl::dynamic_shared_pointer_cast<MeshNode>(currChild);
+		if (!node)
+		{
+			continue;
+		}
+
+		MeshNodeSnapshot snapshot;
+		snapshot.Node = node;
+		snapshot.AbsoluteTransform = currChild->GetAbsoluteTransform().GetMatrix();
+		if (node->MatIndex != uint32_t(-1))
+		{
+			snapshot.AlbedoMap = inMaterials[node->MatIndex].AlbedoMap;
+		}
+
+		outNodes.push_back(eastl::move(snapshot));
 	}
 }
 
-bool SoftwareRasterizer::TryGetPixelPos(const int32_t X, const int32_t Y, int32_t& outPixelPos)
+// Thread owning the scene graph, copies what drawing the model reads of it
+static void GatherSceneSnapshot(const eastl::shared_ptr<Model3D>& inModel, SceneSnapshot& outScene)
 {
-	outPixelPos = Y * ImageWidth + X;
-	const bool bValidPixel = X >= 0 && Y >= 0 && X < ImageWidth && Y < ImageHeight && outPixelPos >= 0 && (outPixelPos < (ImageWidth * ImageHeight));
+	SceneManager& sManager = SceneManager::Get();
+	const Scene& currentScene = sManager.GetCurrentScene();
 
-	return bValidPixel;
+	outScene.View = currentScene.GetMainCameraLookAt();
+	outScene.MeshNodes.clear();
+	GatherMeshNodeSnapshots(inModel->GetChildren(), inModel->Materials, outScene.MeshNodes);
 }
 
-inline int32_t Get2DCrossProductMagnitude(const glm::vec2i& A, const glm::vec2i& B)
+void RenderThreadRun(SoftwareRasterizer* inRasterizer)
 {
-	// |a.x b.x| or |a.x a.y|
-	// |a.y b.y|    |b.x b.y|
-	// determinant of M == det of transpose of M
+	inRasterizer->RunRenderThread();
+}
+
+void SoftwareRasterizer::StartRenderThread()
+{
+	ASSERT(!RenderThread.joinable());
+
+	// Anything a previous render thread left behind is dropped, its frames are not presented
+	CompletedFrame completed;
+	while (CompletedFrames.TryPop(completed))
+	{
+	}
+
+	int32_t freeBufferIdx = -1;
+	while (FreeColorBuffers.TryPop(freeBufferIdx))
+	{
+	}
+
+	PresentedColorBuffer = -1;
+	bStopRenderThread.store(false);
+
+	for (int32_t bufferIdx = 0; bufferIdx < NUM_COLOR_BUFFERS; ++bufferIdx)
+	{
+		FreeColorBuffers.TryPush(bufferIdx);
+	}
+
+	RenderThread = std::thread(RenderThreadRun, this);
+	SetThreadDescription(RenderThread.native_handle(), L"Software Rasterizer Render Thread");
+}
+
+void SoftwareRasterizer::StopRenderThread()
+{
+	if (!RenderThread.joinable())
+	{
+		return;
+	}
+
+	// The frame in flight is finished first
+	{
+		std::unique_lock lock(FrameRequestMutex);
+		bStopRenderThread.store(true);
+		RenderThreadWakeCondition.notify_one();
+	}
+
+	RenderThread.join();
+}
+
+void SoftwareRasterizer::RunRenderThread()
+{
+	while (true)
+	{
+		int32_t colorBufferIdx = -1;
+		FrameRequest request;
+		{
+			// Woken by SubmitFrame, by AcquireCompletedFrame when it frees a buffer and by StopRenderThread
+			std::unique_lock lock(FrameRequestMutex);
+			RenderThreadWakeCondition.wait(lock, [this, &colorBufferIdx]()
+				{
+					// A free buffer first, so that the request is only taken once it can be rendered and is as recent as possible
+					if (colorBufferIdx < 0)
+					{
+						FreeColorBuffers.TryPop(colorBufferIdx);
+					}
+
+					return bStopRenderThread.load() || (colorBufferIdx >= 0 && bFrameRequestPending);
+				});
+
+			if (bStopRenderThread.load())
+			{
+				return;
+			}
+
+			// Takes the request submitted last
+			eastl::swap(request, PendingFrameRequest);
+			bFrameRequestPending = false;
+		}
+
+		// Allocated and pointed at by StartFrame
+		CurrentColorBuffer = colorBufferIdx;
+
+		if (request.bRunScalingBenchmark)
+		{
+			RunScalingBenchmark(request.Scene, request.Settings, request.CullMode, request.DepthTestMode);
+		}
+
+		StartFrame(request.Settings);
+		DrawScene(request.Scene, request.CullMode, request.DepthTestMode);
+		FinishFrame();
+
+		CompletedFrame completed;
+		completed.ColorBufferIdx = colorBufferIdx;
+		completed.Stats = Stats;
+
+		// Can not fail, there are as many slots as buffers
+		CompletedFrames.TryPush(completed);
+	}
+}
+
+void SoftwareRasterizer::SubmitFrame(const eastl::shared_ptr<Model3D>& inModel, const ETriangleCullMode inCullMode, const EDepthTestMode inDepthTestMode)
+{
+	DrawDebugUI();
+
+	// Scene state and settings are read here on the main thread, the render thread only gets copies
+	FrameRequest request;
+	GatherSceneSnapshot(inModel, request.Scene);
+	request.Settings = GetDebugUISettings();
+	request.CullMode = inCullMode;
+	request.DepthTestMode = inDepthTestMode;
+	request.bRunScalingBenchmark = bScalingBenchmarkRequested;
+	bScalingBenchmarkRequested = false;
+
+	std::unique_lock lock(FrameRequestMutex);
+
+	// A replaced request still runs its benchmark with this one
+	request.bRunScalingBenchmark |= bFrameRequestPending && PendingFrameRequest.bRunScalingBenchmark;
+
+	// Swapped, so the replaced request is freed once the lock is released
+	eastl::swap(PendingFrameRequest, request);
+	bFrameRequestPending = true;
+	RenderThreadWakeCondition.notify_one();
+}
+
+bool SoftwareRasterizer::AcquireCompletedFrame()
+{
+	// Only the newest completed frame is presented, older ones go straight back to the render thread
+	bool bFreedBuffer = false;
+	CompletedFrame completed;
+	while (CompletedFrames.TryPop(completed))
+	{
+		if (PresentedColorBuffer >= 0)
+		{
+			FreeColorBuffers.TryPush(PresentedColorBuffer);
+			bFreedBuffer = true;
+		}
+
+		PresentedColorBuffer = completed.ColorBufferIdx;
+		PresentedStats = completed.Stats;
+	}
+
+	if (bFreedBuffer)
+	{
+		// Locked so the render thread can not miss the buffer between checking for one and waiting
+		std::unique_lock lock(FrameRequestMutex);
+		RenderThreadWakeCondition.notify_one();
+	}
+
+	return PresentedColorBuffer >= 0;
+}
+
+void SoftwareRasterizer::ResolvePresentedImage(uint8_t* outImage, const uint64_t inRowPitch) const
+{
+	ASSERT(PresentedColorBuffer >= 0);
+
+	// The render thread does not touch the presented target until it is handed back
+	ResolveImage(PresentedColorBuffer, outImage, inRowPitch);
+}
+
+void SoftwareRasterizer::BeginFrame()
+{
+	DrawDebugUI();
+	StartFrame(GetDebugUISettings());
+}
+
+void SoftwareRasterizer::DrawDebugUI()
+{
+	ImGui::Begin("Software Rasterizer");
+	ImGui::Checkbox("Draw Triangle Wireframe", &bDrawTriangleWireframe);
+	ImGui::Checkbox("Draw Only Backface culled", &bDrawOnlyBackfaceCulled);
+	ImGui::Checkbox("Use Z-Buffer", &bUseZBuffer);
+	ImGui::Checkbox("Use Reference Rasterizer (Full BBox)", &bUseReferenceRasterizer);
+	ImGui::Checkbox("Use SIMD Rasterizer (" SIMD_ISA_NAME ")", &bUseSIMDRasterizer);
+	ImGui::Checkbox("Use Visibility Buffer", &bUseVisibilityBuffer);
+	ImGui::Checkbox("Use Occlusion Culling", &bUseOcclusionCulling);
+	ImGui::SliderInt("Occluders (nearest nodes)", &occluderCount, 0, 64);
+	ImGui::Combo("Depth Format", &depthFormat, "Float32\0Unorm16\0Unorm24\0Float32 Reversed-Z\0");
+	ImGui::Combo("Color Format", &colorFormat, "RGBA8\0RGBA16F\0R11G11B10F\0RGB10A2\0");
+	ImGui::Combo("Texture Filter", &textureFilter, "Base Level Point\0Nearest Mip Point\0Trilinear\0");
+	ImGui::Checkbox("Keep Tiles On The Same Workers", &bUseTileAffinity);
+	ImGui::Checkbox("sRGB Encode On Resolve", &bResolveSRGB);
+	ImGui::Checkbox("Dither On Resolve", &bResolveDither);
+	if (ImGui::Button("Run Scaling Benchmark (async only, results in log)"))
+	{
+		RequestScalingBenchmark();
+	}
+
+	// Last completed frame
+	ImGui::Text("Mesh nodes culled: %d", PresentedStats.MeshNodesCulled);
+	ImGui::Text("Occlusion tested: %d, culled: %d, took %.3f ms", PresentedStats.OcclusionNodesTested, PresentedStats.OcclusionNodesCulled, PresentedStats.OcclusionCullingMs);
+	ImGui::Text("Triangles submitted: %d", PresentedStats.TrianglesSubmitted);
+	ImGui::Text("Frustum culled: %d", PresentedStats.FrustumCulled);
+	ImGui::Text("Backface culled: %d", PresentedStats.BackfaceCulled);
+	ImGui::Text("Degenerate culled: %d", PresentedStats.DegenerateCulled);
+	ImGui::Text("No samples culled: %d", PresentedStats.NoSamplesCulled);
+	ImGui::Text("Triangles binned: %d", PresentedStats.TrianglesBinned);
+	ImGui::Text("Hi-Z culled triangles (per tile): %d", PresentedStats.HiZCulledTriangles);
+	ImGui::Text("Hi-Z culled blocks: %d", PresentedStats.HiZCulledBlocks);
+	ImGui::Text("Tiles left cleared: %d", PresentedStats.TilesLeftCleared);
+	ImGui::Text("Tile rasterization: %.3f ms on %d threads", PresentedStats.TileRasterMs, PresentedStats.NumRasterThreads);
+	ImGui::Text("Pipeline states: %d, %d of them without compiled kernels", PresentedStats.PipelineStates, PresentedStats.GenericPipelineStates);
+	ImGui::End();
+}
+
+void SoftwareRasterizer::StartFrame(const SoftwareRasterizerSettings& inSettings)
+{
+	Stats = SoftwareRasterizerStats();
+
+	// Only changes between frames, the targets and the clear below already use the new formats
+	DepthFormat = inSettings.DepthFormat;
+	ColorTargetFormat = inSettings.ColorFormat;
+	bDepthTestEnabled = inSettings.bDepthTest;
+	bVisibilityBufferEnabled = inSettings.bVisibilityBuffer;
+	bKeepTileAffinity = inSettings.bKeepTileAffinity;
+	TextureFilter = inSettings.TextureFilter;
+	bShowCulledTriangles = inSettings.bShowCulledTriangles;
+	bDrawWireframe = inSettings.bDrawWireframe;
+	bReferenceRasterizer = inSettings.bUseReferenceRasterizer;
+	bSIMDRasterizer = inSettings.bUseSIMDRasterizer;
+	bOcclusionCulling = inSettings.bUseOcclusionCulling;
+	NumOccluders = inSettings.NumOccluders;
+
+	AllocateRenderTargets();
+	ClearImageBuffers();
+
+	FramePipelineStates.clear();
+	TriangleSetups.clear();
+	VaryingPlanes.clear();
+	for (eastl::vector<uint32_t>& bin : TileBins)
+	{
+		bin.clear();
+	}
+}
+
+void SoftwareRasterizer::RunScalingBenchmark(const SceneSnapshot& inScene, const SoftwareRasterizerSettings& inSettings, const ETriangleCullMode inCullMode, const EDepthTestMode inDepthTestMode)
+{
+	constexpr int32_t numWarmupFrames = 4;
+	constexpr int32_t numMeasuredFrames = 32;
+
+	JobSystem& jobSystem = JobSystem::Get();
+	const int32_t prevNumActiveWorkers = jobSystem.GetNumActiveWorkers();
+
+	// Thread counts include this thread, which rasterizes tiles too
+	eastl::vector<int32_t> threadCounts;
+	for (int32_t numThreads = 1; numThreads < jobSystem.GetNumWorkers() + 1; numThreads *= 2)
+	{
+		threadCounts.push_back(numThreads);
+	}
+	threadCounts.push_back(jobSystem.GetNumWorkers() + 1);
+
+	LOG_INFO("Scaling benchmark: %d frames per run, %d tiles, workers pinned: %d", numMeasuredFrames, NumTotalTiles, jobSystem.AreWorkersPinned() ? 1 : 0);
+
+	// Average tile times of every run, without then with tile affinity
+	eastl::vector<float> runTileMs[2];
+	float singleThreadTileMs = 0.f;
+	for (const bool bTileAffinity : { false, true })
+	{
+		for (const int32_t numThreads : threadCounts)
+		{
+			jobSystem.SetNumActiveWorkers(numThreads - 1);
+
+			float frameMs = 0.f;
+			float tileMs = 0.f;
+			for (int32_t frameIdx = 0; frameIdx < numWarmupFrames + numMeasuredFrames; ++frameIdx)
+			{
+				const auto startTime = std::chrono::high_resolution_clock::now();
+
+				StartFrame(inSettings);
+				bKeepTileAffinity = bTileAffinity;
+				DrawScene(inScene, inCullMode, inDepthTestMode);
+				FinishFrame();
+
+				const auto endTime = std::chrono::high_resolution_clock::now();
+				if (frameIdx >= numWarmupFrames)
+				{
+					frameMs += std::chrono::duration<float, std::milli>(endTime - startTime).count();
+					tileMs += Stats.TileRasterMs;
+				}
+			}
+
+			frameMs /= numMeasuredFrames;
+			tileMs /= numMeasuredFrames;
+			if (numThreads == 1 && !bTileAffinity)
+			{
+				singleThreadTileMs = tileMs;
+			}
+			runTileMs[bTileAffinity ? 1 : 0].push_back(tileMs);
+
+			LOG_INFO("Scaling benchmark: %2d threads, tile affinity %d: frame %.3f ms, tiles %.3f ms, tile speedup %.2fx",
+				numThreads, bTileAffinity ? 1 : 0, frameMs, tileMs, tileMs > 0.f ? singleThreadTileMs / tileMs : 0.f);
+		}
+	}
+
+	// Conclusion, the fewest threads that get within 5% of the fastest run, past that more threads only add contention
+	const eastl::vector<float>& affinityTileMs = runTileMs[1];
+	const int32_t fastestIdx = static_cast<int32_t>(eastl::min_element(affinityTileMs.begin(), affinityTileMs.end()) - affinityTileMs.begin());
+	int32_t enoughIdx = fastestIdx;
+	while (enoughIdx > 0 && affinityTileMs[enoughIdx - 1] <= affinityTileMs[fastestIdx] * 1.05f)
+	{
+		--enoughIdx;
+	}
+
+	const int32_t allThreadsIdx = static_cast<int32_t>(threadCounts.size()) - 1;
+	const float efficiency = singleThreadTileMs / (affinityTileMs[enoughIdx] * threadCounts[enoughIdx]);
+	const float affinityGain = runTileMs[0][allThreadsIdx] / affinityTileMs[allThreadsIdx] - 1.f;
+	LOG_INFO("Scaling benchmark: tiles scale up to %d threads, %.2fx at %.0f%% efficiency, tile affinity on all threads is %.1f%% faster",
+		threadCounts[enoughIdx], singleThreadTileMs / affinityTileMs[enoughIdx], efficiency * 100.f, affinityGain * 100.f);
+
+	jobSystem.SetNumActiveWorkers(prevNumActiveWorkers);
+}
+
+void SoftwareRasterizer::ClearImageBuffers()
+{
+	eastl::fill(TileCleared.begin(), TileCleared.end(), uint8_t(1));
+}
+
+void SoftwareRasterizer::InitializeClearedTile(const int32_t inTileIdx)
+{
+	if (!TileCleared[inTileIdx])
+	{
+		return;
+	}
+
+	DispatchDepthFormat(DepthFormat, [this, inTileIdx](auto inDepthFormat)
+		{
+			DispatchColorFormat(ColorTargetFormat, [this, inTileIdx](auto inColorFormat)
+				{
+					ClearTile<decltype(inDepthFormat)::value, decltype(inColorFormat)::value>(inTileIdx);
+				});
+		});
+}
+
+void SoftwareRasterizer::InitializeClearedTileAt(const int32_t inX, const int32_t inY)
+{
+	InitializeClearedTile((inY / BIN_TILE_SIZE) * NumTilesX + inX / BIN_TILE_SIZE);
+}
+
+template<EDepthFormat Format, EColorFormat ColorFormat>
+void SoftwareRasterizer::ClearTile(const int32_t inTileIdx)
+{
+	using DepthTraits = DepthFormatTraits<Format>;
+	using StorageType = typename DepthTraits::StorageType;
+	using ColorTraits = ColorFormatTraits<ColorFormat>;
+	using ColorStorageType = typename ColorTraits::StorageType;
+
+	const int32_t tileMinX = (inTileIdx % NumTilesX) * BIN_TILE_SIZE;
+	const int32_t tileMinY = (inTileIdx / NumTilesX) * BIN_TILE_SIZE;
+	const int32_t tileEndX = glm::min(tileMinX + BIN_TILE_SIZE, ImageWidth);
+	const int32_t tileEndY = glm::min(tileMinY + BIN_TILE_SIZE, ImageHeight);
+
+	StorageType clearDepth;
+	DepthTraits::Store(&clearDepth, DepthTraits::ClearKey);
+	StorageType* depthData = reinterpret_cast<StorageType*>(DepthData);
+	const ColorStorageType clearColor = ColorTraits::Pack(CLEAR_COLOR);
+	ColorStorageType* colorData = reinterpret_cast<ColorStorageType*>(ColorTarget);
+
+	// Tiles are a whole number of blocks, so the blocks and their Hi-Z are owned by the tile too
+	// Blocks are contiguous, padding past the image edge included
+	for (int32_t blockY = tileMinY / RASTER_BLOCK_SIZE; blockY <= (tileEndY - 1) / RASTER_BLOCK_SIZE; ++blockY)
+	{
+		for (int32_t blockX = tileMinX / RASTER_BLOCK_SIZE; blockX <= (tileEndX - 1) / RASTER_BLOCK_SIZE; ++blockX)
+		{
+			const int32_t blockStart = (blockY * NumBlocksX + blockX) * RASTER_BLOCK_PIXELS;
+			eastl::fill_n(&colorData[blockStart], RASTER_BLOCK_PIXELS, clearColor);
+
+			if (bDepthTestEnabled)
+			{
+				eastl::fill_n(&depthData[blockStart], RASTER_BLOCK_PIXELS, clearDepth);
+			}
+
+			if (bVisibilityBufferEnabled)
+			{
+				memset(&VisibilityData[blockStart], 0, RASTER_BLOCK_PIXELS * sizeof(uint32_t));
+			}
+
+			HiZData[blockY * HiZWidth + blockX] = DepthTraits::ClearKey;
+		}
+	}
+
+	TileCleared[inTileIdx] = 0;
+}
+
+template<EColorFormat ColorFormat>
+void SoftwareRasterizer::ResolveClearedTiles()
+{
+	using ColorTraits = ColorFormatTraits<ColorFormat>;
+	using ColorStorageType = typename ColorTraits::StorageType;
+
+	const ColorStorageType clearColor = ColorTraits::Pack(CLEAR_COLOR);
+	ColorStorageType* colorData = reinterpret_cast<ColorStorageType*>(ColorTarget);
+
+	for (int32_t tileIdx = 0; tileIdx < NumTotalTiles; ++tileIdx)
+	{
+		if (!TileCleared[tileIdx])
+		{
+			continue;
+		}
+
+		const int32_t tileMinX = (tileIdx % NumTilesX) * BIN_TILE_SIZE;
+		const int32_t tileMinY = (tileIdx / NumTilesX) * BIN_TILE_SIZE;
+		const int32_t tileEndX = glm::min(tileMinX + BIN_TILE_SIZE, ImageWidth);
+		const int32_t tileEndY = glm::min(tileMinY + BIN_TILE_SIZE, ImageHeight);
+
+		for (int32_t blockY = tileMinY / RASTER_BLOCK_SIZE; blockY <= (tileEndY - 1) / RASTER_BLOCK_SIZE; ++blockY)
+		{
+			for (int32_t blockX = tileMinX / RASTER_BLOCK_SIZE; blockX <= (tileEndX - 1) / RASTER_BLOCK_SIZE; ++blockX)
+			{
+				eastl::fill_n(&colorData[(blockY * NumBlocksX + blockX) * RASTER_BLOCK_PIXELS], RASTER_BLOCK_PIXELS, clearColor);
+			}
+		}
+
+		// Only color is resolved, the tile's depth stays stale until the next clear flags it again
+		TileCleared[tileIdx] = 0;
+		++Stats.TilesLeftCleared;
+	}
+}
+
+void SoftwareRasterizer::WriteColor(const int32_t inPixelPos, const uint32_t inRGBA)
+{
+	DispatchColorFormat(ColorTargetFormat, [this, inPixelPos, inRGBA](auto inColorFormat)
+		{
+			using ColorTraits = ColorFormatTraits<decltype(inColorFormat)::value>;
+			ColorTraits::Store(&reinterpret_cast<typename ColorTraits::StorageType*>(ColorTarget)[inPixelPos], inRGBA);
+		});
+}
+
+void SoftwareRasterizer::ResolveImage(const int32_t inColorBufferIdx, uint8_t* outImage, const uint64_t inRowPitch) const
+{
+	// Read once, the main thread might change them while workers resolve
+	const bool bEncodeSRGB = bResolveSRGB;
+	const bool bDither = bResolveDither;
+	const uint8_t* colorTarget = ColorTargets[inColorBufferIdx].GetData();
+
+	DispatchColorFormat(ColorTargetFormats[inColorBufferIdx], [this, colorTarget, outImage, inRowPitch, bEncodeSRGB, bDither](auto inColorFormat)
+		{
+			using ColorFormatConstant = decltype(inColorFormat);
+			// Bands of a block row or more, every band reads whole blocks and writes whole rows
+			JobSystem::Get().ParallelFor(NumBlocksY, 1, [this, colorTarget, outImage, inRowPitch, bEncodeSRGB, bDither](const int32_t inBegin, const int32_t inEnd)
+				{
+					ResolveBlockRows<ColorFormatConstant::value>(colorTarget, outImage, inRowPitch, inBegin, inEnd, bEncodeSRGB, bDither);
+				});
+		});
+}
+
+template<EColorFormat ColorFormat>
+void SoftwareRasterizer::ResolveBlockRows(const uint8_t* inColorTarget, uint8_t* outImage, const uint64_t inRowPitch, const int32_t inBeginBlockY, const int32_t inEndBlockY, const bool inEncodeSRGB, const bool inDither) const
+{
+	using namespace SIMD;
+	using ColorStorageType = typename ColorFormatTraits<ColorFormat>::StorageType;
+
+	const int32_t numWholeBlocksX = ImageWidth / RASTER_BLOCK_SIZE;
+	const int32_t numLastBlockPixels = ImageWidth - numWholeBlocksX * RASTER_BLOCK_SIZE;
+
+	for (int32_t y = inBeginBlockY * RASTER_BLOCK_SIZE; y < glm::min(inEndBlockY * RASTER_BLOCK_SIZE, ImageHeight); ++y)
+	{
+		// y goes down in D3D
+		uint32_t* destRow = reinterpret_cast<uint32_t*>(outImage + (ImageHeight - 1 - y) * inRowPitch);
+		const ColorStorageType* srcRow = &reinterpret_cast<const ColorStorageType*>(inColorTarget)[GetPixelPos(0, y)];
+		const Int8 roundOffsets = inDither ? LoadU(DITHER_ROWS[y & 3]) : Set1Int(128);
+
+		// Consecutive blocks of a block row are RASTER_BLOCK_PIXELS apart
+		for (int32_t blockX = 0; blockX < NumBlocksX; ++blockX)
+		{
+			const Int8 pixels = ResolvePixels<ColorFormat>(&srcRow[blockX * RASTER_BLOCK_PIXELS], roundOffsets, inEncodeSRGB);
+
+			if (blockX < numWholeBlocksX)
+			{
+				StoreU(&destRow[blockX * RASTER_BLOCK_SIZE], pixels);
+			}
+			else
+			{
+				alignas(32) uint32_t lastPixels[Width];
+				StoreU(lastPixels, pixels);
+				memcpy(&destRow[blockX * RASTER_BLOCK_SIZE], lastPixels, numLastBlockPixels * sizeof(uint32_t));
+			}
+		}
+	}
+}
+
+int32_t SoftwareRasterizer::GetPixelPos(const int32_t inX, const int32_t inY) const
+{
+	const int32_t blockIdx = (inY / RASTER_BLOCK_SIZE) * NumBlocksX + inX / RASTER_BLOCK_SIZE;
+
+	return blockIdx * RASTER_BLOCK_PIXELS + (inY & (RASTER_BLOCK_SIZE - 1)) * RASTER_BLOCK_SIZE + (inX & (RASTER_BLOCK_SIZE - 1));
+}
+
+bool SoftwareRasterizer::TryGetPixelPos(const int32_t X, const int32_t Y, int32_t& outPixelPos)
+{
+	const bool bValidPixel = X >= 0 && Y >= 0 && X < ImageWidth && Y < ImageHeight;
+	if (bValidPixel)
+	{
+		outPixelPos = GetPixelPos(X, Y);
+	}
+
+	return bValidPixel;
+}
+
+void SoftwareRasterizer::TransformVertices(const eastl::vector<SimpleVertex>& inVertices, const glm::mat4& inWorldToClip)
+{
+	const int32_t numVertices = static_cast<int32_t>(inVertices.size());
+	PostTransformVertexBuffer& outBuffer = PostTransformVertices;
+	outBuffer.Resize(numVertices);
+
+	for (int32_t i = 0; i < numVertices; ++i)
+	{
+		const glm::vec4 clipSpacePos = TransformPosition(inVertices[i].Position, inWorldToClip);
+
+		outBuffer.ClipX[i] = clipSpacePos.x;
+		outBuffer.ClipY[i] = clipSpacePos.y;
+		outBuffer.ClipZ[i] = clipSpacePos.z;
+		outBuffer.ClipW[i] = clipSpacePos.w;
+	}
+}
+
+// Vertex stage outputs of a vertex, its transformed position and its attributes as varyings
+inline VtxShaderOutput AssembleVertex(const PostTransformVertexBuffer& inPostTransform, const uint32_t inIdx, const SimpleVertex& inVertex)
+{
+	VtxShaderOutput out;
+	out.ClipSpacePos = inPostTransform.GetClipSpacePos(inIdx);
+	out.Varyings[Varying_TexCoordU] = inVertex.TexCoords.x;
+	out.Varyings[Varying_TexCoordV] = inVertex.TexCoords.y;
+	out.Varyings[Varying_NormalX] = inVertex.Normal.x;
+	out.Varyings[Varying_NormalY] = inVertex.Normal.y;
+	out.Varyings[Varying_NormalZ] = inVertex.Normal.z;
+
+	return out;
+}
+
+void SoftwareRasterizer::DrawMeshNodes(const eastl::vector<MeshNodeSnapshot>& inNodes, const glm::mat4& inProj, const glm::mat4& inView)
+{
+	for (const MeshNodeSnapshot& snapshot : inNodes)
+	{
+		const MeshNode* node = snapshot.Node.get();
+		const glm::mat4 worldToClip = inProj * inView * snapshot.AbsoluteTransform;
+
+		// Skip nodes fully outside of the frustum before any per vertex work
+		// Planes are extracted from the full matrix, so the object space bounds can be tested directly
+		if (node->BoundingBox.IsValid())
+		{
+			const Frustum nodeFrustum = Frustum::FromMatrix(worldToClip);
+			if (!nodeFrustum.Intersects(node->BoundingSphere) || !nodeFrustum.Intersects(node->BoundingBox))
+			{
+				++Stats.MeshNodesCulled;
+				continue;
+			}
+		}
+
+		if (!OccludedNodes.empty() && eastl::binary_search(OccludedNodes.begin(), OccludedNodes.end(), node))
+		{
+			continue;
+		}
+
+		const SwizzledTexture* usedImage = snapshot.AlbedoMap ? &snapshot.AlbedoMap->SwizzledCPUImage : nullptr;
+
+		// Kernels are picked once for the whole node
+		SetDrawPipelineState(usedImage);
+
+		const eastl::vector<SimpleVertex>& CPUVertices = node->CPUVertices;
+		const eastl::vector<uint32_t>& CPUIndices = node->CPUIndices;
+
+		const uint32_t numIndices = static_cast<uint32_t>(CPUIndices.size());
+		ASSERT(numIndices % 3 == 0);
+		const uint32_t numTriangles = numIndices / 3;
+
+		// Vtx Shader
+		// Every vertex of the node is transformed to clip space once, triangles then index into the results
+		TransformVertices(CPUVertices, worldToClip);
+		const PostTransformVertexBuffer& postTransform = PostTransformVertices;
+
+		// Primitive assembly
+		for (uint32_t triangleIdx = 0; triangleIdx < numTriangles; ++triangleIdx)
+		{
+			const uint32_t idxStart = triangleIdx * 3;
+
+			{
+				const uint32_t idxA = CPUIndices[idxStart];
+				const uint32_t idxB = CPUIndices[idxStart + 1];
+				const uint32_t idxC = CPUIndices[idxStart + 2];
+
+				const SimpleVertex& vtxA = CPUVertices[idxA];
+				const SimpleVertex& vtxB = CPUVertices[idxB];
+				const SimpleVertex& vtxC = CPUVertices[idxC];
+
+				ClipTriangle(AssembleVertex(postTransform, idxA, vtxA), AssembleVertex(postTransform, idxB, vtxB), AssembleVertex(postTransform, idxC, vtxC), usedImage);
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::DrawModel(const eastl::shared_ptr<Model3D>& inModel, const ETriangleCullMode inCullMode, const EDepthTestMode inDepthTestMode)
+{
+	// Same path as the render thread, drawing only reads the snapshot
+	SceneSnapshot scene;
+	GatherSceneSnapshot(inModel, scene);
+
+	DrawScene(scene, inCullMode, inDepthTestMode);
+}
+
+void SoftwareRasterizer::DrawScene(const SceneSnapshot& inScene, const ETriangleCullMode inCullMode, const EDepthTestMode inDepthTestMode)
+{
+	CurrentCullMode = inCullMode;
+	CurrentDepthTestMode = inDepthTestMode;
+
+	const float orthoAABBHalfLength = 5.f;
+	//const glm::mat4 projection = glm::orthoLH_ZO(-orthoAABBHalfLength, orthoAABBHalfLength, -orthoAABBHalfLength, orthoAABBHalfLength, 0.f, orthoAABBHalfLength * 2);
+	const float aspectRatio = static_cast<float>(ImageWidth) / static_cast<float>(ImageHeight);
+	const glm::mat4 standardProjection = glm::perspectiveLH_ZO(glm::radians(CAMERA_FOV), aspectRatio, CAMERA_NEAR, CAMERA_FAR);
+	// Swapping near and far maps the near plane to 1 and the far plane to 0
+	const glm::mat4 projection = IsReversedZ(DepthFormat) ? glm::perspectiveLH_ZO(glm::radians(CAMERA_FOV), aspectRatio, CAMERA_FAR, CAMERA_NEAR) : standardProjection;
+
+	const glm::mat4& view = inScene.View;
+
+	OccludedNodes.clear();
+	if (bOcclusionCulling)
+	{
+		// The occlusion buffer has its own depth, always in the standard range
+		CullOccludedNodes(inScene.MeshNodes, standardProjection, view);
+	}
+
+	DrawMeshNodes(inScene.MeshNodes, projection, view);
+}
+
+void SoftwareRasterizer::CullOccludedNodes(const eastl::vector<MeshNodeSnapshot>& inNodes, const glm::mat4& inProj, const glm::mat4& inView)
+{
+	const auto startTime = std::chrono::high_resolution_clock::now();
+
+	OcclusionCandidates.clear();
+
+	for (const MeshNodeSnapshot& snapshot : inNodes)
+	{
+		// Nodes without bounds are never culled
+		const MeshNode* node = snapshot.Node.get();
+		if (!node->BoundingBox.IsValid())
+		{
+			continue;
+		}
+
+		const glm::mat4 objectToClip = inProj * inView * snapshot.AbsoluteTransform;
+
+		// Frustum culled nodes are neither occluders nor worth testing
+		const Frustum nodeFrustum = Frustum::FromMatrix(objectToClip);
+		if (!nodeFrustum.Intersects(node->BoundingSphere) || !nodeFrustum.Intersects(node->BoundingBox))
+		{
+			continue;
+		}
+
+		float distance = (std::numeric_limits<float>::max)();
+		for (const glm::vec3& corner : node->BoundingBox.GetVertices())
+		{
+			distance = glm::min(distance, (objectToClip * glm::vec4(corner, 1.f)).w);
+		}
+
+		OcclusionCandidates.push_back({ node, objectToClip, distance });
+	}
+
+	eastl::sort(OcclusionCandidates.begin(), OcclusionCandidates.end(), [](const OcclusionCandidate& inA, const OcclusionCandidate& inB) { return inA.Distance < inB.Distance; });
+
+	// Nearest nodes are the occluders
+	OcclusionCuller.Clear();
+	const int32_t numOccluders = glm::min(NumOccluders, static_cast<int32_t>(OcclusionCandidates.size()));
+	for (int32_t i = 0; i < numOccluders; ++i)
+	{
+		OcclusionCuller.RasterizeOccluder(OcclusionCandidates[i].Node->CPUVertices, OcclusionCandidates[i].Node->CPUIndices, OcclusionCandidates[i].ObjectToClip);
+	}
+
+	// Everything else is tested against them
+	for (int32_t i = numOccluders; i < static_cast<int32_t>(OcclusionCandidates.size()); ++i)
+	{
+		++Stats.OcclusionNodesTested;
+		if (OcclusionCuller.IsOccluded(OcclusionCandidates[i].Node->BoundingBox, OcclusionCandidates[i].ObjectToClip))
+		{
+			OccludedNodes.push_back(OcclusionCandidates[i].Node);
+		}
+	}
+
+	Stats.OcclusionNodesCulled += static_cast<int32_t>(OccludedNodes.size());
+
+	// Looked up while drawing
+	eastl::sort(OccludedNodes.begin(), OccludedNodes.end());
+
+	const auto endTime = std::chrono::high_resolution_clock::now();
+	Stats.OcclusionCullingMs += std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+
+// Clip space vertex attributes are linear, so clipped vertices can simply lerp all of them
+inline VtxShaderOutput LerpVertex(const VtxShaderOutput& inA, const VtxShaderOutput& inB, const float inT)
+{
+	VtxShaderOutput out;
+	out.ClipSpacePos = glm::mix(inA.ClipSpacePos, inB.ClipSpacePos, inT);
+	for (int32_t slot = 0; slot < Varying_Count; ++slot)
+	{
+		out.Varyings[slot] = glm::mix(inA.Varyings[slot], inB.Varyings[slot], inT);
+	}
+
+	return out;
+}
+
+inline const glm::vec4& GetClipSpacePos(const VtxShaderOutput& inVertex)
+{
+	return inVertex.ClipSpacePos;
+}
+
+enum ClipPlaneBits : uint32_t
+{
+	CLIP_LEFT	= 1 << 0,
+	CLIP_RIGHT	= 1 << 1,
+	CLIP_BOTTOM	= 1 << 2,
+	CLIP_TOP	= 1 << 3,
+	CLIP_NEAR	= 1 << 4,
+	CLIP_FAR	= 1 << 5,
+};
+
+// Planes the position is outside of, for the given x and y extents in NDC
+// With reversed Z the near plane is at z = w and the far plane at z = 0
+inline uint32_t ComputeOutCode(const glm::vec4& inClipSpacePos, const float inExtentX, const float inExtentY, const bool inReversedZ)
+{
+	const glm::vec4& p = inClipSpacePos;
+	uint32_t code = 0;
+	code |= p.x < -inExtentX * p.w ? CLIP_LEFT : 0;
+	code |= p.x > inExtentX * p.w ? CLIP_RIGHT : 0;
+	code |= p.y < -inExtentY * p.w ? CLIP_BOTTOM : 0;
+	code |= p.y > inExtentY * p.w ? CLIP_TOP : 0;
+	code |= (inReversedZ ? p.z > p.w : p.z < 0.f) ? CLIP_NEAR : 0;
+	code |= (inReversedZ ? p.z < 0.f : p.z > p.w) ? CLIP_FAR : 0;
+
+	return code;
+}
+
+void SoftwareRasterizer::SetDrawPipelineState(const SwizzledTexture* inTexture)
+{
+	// Keys are normalized so that states drawing the same way share their kernels
+	PipelineStateKey key;
+	key.DepthFormat = DepthFormat;
+	key.ColorFormat = ColorTargetFormat;
+	key.FlatColor = ConvertToRGBA(glm::vec4(1.f, 0.f, 1.f, 1.f));
+
+	if (bDepthTestEnabled)
+	{
+		key.Flags |= Ps_DepthTest;
+
+		// The visibility buffer only supports early Z, its shading pass can not affect depth anymore
+		if (CurrentDepthTestMode == EDepthTestMode::LateZ && !bVisibilityBufferEnabled)
+		{
+			key.Flags |= Ps_LateZ;
+		}
+	}
+
+	if (bVisibilityBufferEnabled)
+	{
+		key.Flags |= Ps_VisibilityBuffer;
+	}
+
+	if (inTexture && inTexture->IsValid())
+	{
+		key.Flags |= Ps_Textured;
+		key.TextureFilter = TextureFilter;
+	}
+
+	// Debug view, triangles that pass culling only write depth
+	if (!bShowCulledTriangles)
+	{
+		key.Flags |= Ps_ColorWrite;
+	}
+
+	key.VaryingMask = GetVaryingMask(key.Flags);
+	CurrentPipelineState = GetPipelineStateIdx(key);
+
+	if (bShowCulledTriangles)
+	{
+		key.Flags = (key.Flags & ~Ps_Textured) | Ps_ColorWrite;
+		key.TextureFilter = ETextureFilter::BaseLevelPoint;
+		key.VaryingMask = GetVaryingMask(key.Flags);
+		key.FlatColor = ConvertToRGBA(glm::vec4(1.f, 0.f, 0.f, 1.f));
+		CurrentCulledPipelineState = GetPipelineStateIdx(key);
+	}
+}
+
+uint16_t SoftwareRasterizer::GetPipelineStateIdx(const PipelineStateKey& inKey)
+{
+	// A frame only draws with a handful of states
+	for (size_t i = 0; i < FramePipelineStates.size(); ++i)
+	{
+		if (FramePipelineStates[i].Key == inKey)
+		{
+			return static_cast<uint16_t>(i);
+		}
+	}
+
+	ASSERT(FramePipelineStates.size() < UINT16_MAX);
+
+	FramePipelineState state;
+	state.Key = inKey;
+	GetPipelineKernels(inKey, state);
+	FramePipelineStates.push_back(state);
+
+	++Stats.PipelineStates;
+	if (state.bGeneric)
+	{
+		++Stats.GenericPipelineStates;
+	}
+
+	return static_cast<uint16_t>(FramePipelineStates.size() - 1);
+}
+
+void SoftwareRasterizer::GetPipelineKernels(const PipelineStateKey& inKey, FramePipelineState& outState)
+{
+	const bool bCompiled = DispatchPipelineState(inKey, CompiledPipelineStates(), [this, &inKey, &outState](auto inState)
+		{
+			using State = decltype(inState);
+			outState.Rasterize = &SoftwareRasterizer::RasterizeTriangle<State>;
+			outState.Shade = State::HasFlag(inKey, Ps_ColorWrite) ? &SoftwareRasterizer::ShadeFragment<State> : nullptr;
+		});
+
+	outState.bGeneric = !bCompiled;
+}
+
+void SoftwareRasterizer::DrawTriangle(const VtxShaderOutput& A, const VtxShaderOutput& B, const VtxShaderOutput& C, const SwizzledTexture* inTexture)
+{
+	SetDrawPipelineState(inTexture);
+	ClipTriangle(A, B, C, inTexture);
+}
+
+void SoftwareRasterizer::ClipTriangle(const VtxShaderOutput& A, const VtxShaderOutput& B, const VtxShaderOutput& C, const SwizzledTexture* inTexture)
+{
+	// Primitive assembly, clips in homogeneous space before anything is divided by w
+
+	const bool bReversedZ = IsReversedZ(DepthFormat);
+
+	// Triangles fully outside of one of the frustum planes are rejected
+	const uint32_t outCodeA = ComputeOutCode(A.ClipSpacePos, 1.f, 1.f, bReversedZ);
+	const uint32_t outCodeB = ComputeOutCode(B.ClipSpacePos, 1.f, 1.f, bReversedZ);
+	const uint32_t outCodeC = ComputeOutCode(C.ClipSpacePos, 1.f, 1.f, bReversedZ);
+
+	++Stats.TrianglesSubmitted;
+
+	if ((outCodeA & outCodeB & outCodeC) != 0)
+	{
+		++Stats.FrustumCulled;
+		return;
+	}
+
+	// Sides are only clipped against past the guard band, anything inside of it is left to the rasterizer's screen clamp
+	// The guard band is sized so that snapped coordinates always fit the fixed point range
+	const float guardBandX = 1.f + 2.f * GUARD_BAND_PIXELS / static_cast<float>(ImageWidth - 1);
+	const float guardBandY = 1.f + 2.f * GUARD_BAND_PIXELS / static_cast<float>(ImageHeight - 1);
+
+	const uint32_t guardBandOutCode = ComputeOutCode(A.ClipSpacePos, guardBandX, guardBandY, bReversedZ) | ComputeOutCode(B.ClipSpacePos, guardBandX, guardBandY, bReversedZ) | ComputeOutCode(C.ClipSpacePos, guardBandX, guardBandY, bReversedZ);
+
+	// Far plane is left to the depth test
+	const uint32_t planesToClip = guardBandOutCode & ~CLIP_FAR;
+	if (planesToClip == 0)
+	{
+		SetupTriangle(A, B, C, inTexture);
+		return;
+	}
+
+	// Each plane adds at most one vertex, passes ping-pong between the two buffers
+	constexpr int32_t numClipPlanes = 5;
+	constexpr int32_t maxClippedVertices = 3 + numClipPlanes;
+	VtxShaderOutput polygonBuffers[2][maxClippedVertices];
+	VtxShaderOutput* polygon = polygonBuffers[0];
+	VtxShaderOutput* clipped = polygonBuffers[1];
+	polygon[0] = A;
+	polygon[1] = B;
+	polygon[2] = C;
+	int32_t numVertices = 3;
+
+	const glm::vec4 clipPlanes[numClipPlanes] =
+	{
+		glm::vec4(1.f, 0.f, 0.f, guardBandX),	// CLIP_LEFT
+		glm::vec4(-1.f, 0.f, 0.f, guardBandX),	// CLIP_RIGHT
+		glm::vec4(0.f, 1.f, 0.f, guardBandY),	// CLIP_BOTTOM
+		glm::vec4(0.f, -1.f, 0.f, guardBandY),	// CLIP_TOP
+		bReversedZ ? glm::vec4(0.f, 0.f, -1.f, 1.f) : glm::vec4(0.f, 0.f, 1.f, 0.f),	// CLIP_NEAR
+	};
+
+	for (int32_t planeIdx = 0; planeIdx < numClipPlanes && numVertices >= 3; ++planeIdx)
+	{
+		if (planesToClip & (1u << planeIdx))
+		{
+			numVertices = ClipPolygonAgainstPlane(polygon, numVertices, clipPlanes[planeIdx], clipped);
+			std::swap(polygon, clipped);
+		}
+	}
+
+	// Fan triangulation keeps the original winding
+	for (int32_t i = 1; i + 1 < numVertices; ++i)
+	{
+		SetupTriangle(polygon[0], polygon[i], polygon[i + 1], inTexture);
+	}
+}
+
+void SoftwareRasterizer::SetupTriangle(const VtxShaderOutput& A, const VtxShaderOutput& B, const VtxShaderOutput& C, const SwizzledTexture* inTexture)
+{
+	const glm::vec3 A_NDC = HomDivide(A.ClipSpacePos);
+	const glm::vec3 B_NDC = HomDivide(B.ClipSpacePos);
+	const glm::vec3 C_NDC = HomDivide(C.ClipSpacePos);
+
+	// Map from -1..1 to 0..1 (Screen Space)
+	const glm::vec3 vtxAScreenSpace = (A_NDC + 1.f) / 2.f;
+	const glm::vec3 vtxBScreenSpace = (B_NDC + 1.f) / 2.f;
+	const glm::vec3 vtxCScreenSpace = (C_NDC + 1.f) / 2.f;
+
+	// Map to pixel space
+	const glm::vec2 A_PS(vtxAScreenSpace.x * (ImageWidth - 1), vtxAScreenSpace.y * (ImageHeight - 1));
+	const glm::vec2 B_PS(vtxBScreenSpace.x * (ImageWidth - 1), vtxBScreenSpace.y * (ImageHeight - 1));
+	const glm::vec2 C_PS(vtxCScreenSpace.x * (ImageWidth - 1), vtxCScreenSpace.y * (ImageHeight - 1));
+
+	// Snap to the sub-pixel grid, coverage is then decided with exact integer math
+	// Guard band clipping keeps valid vertices in the fixed point range, this only rejects non-finite ones
+	const float maxPixelCoord = static_cast<float>(MAX_SUBPIXEL_COORD / SUBPIXEL_SCALE);
+	const glm::vec2 maxCoord = glm::max(glm::abs(A_PS), glm::max(glm::abs(B_PS), glm::abs(C_PS)));
+	if (!(maxCoord.x < maxPixelCoord && maxCoord.y < maxPixelCoord))
+	{
+		++Stats.DegenerateCulled;
+		return;
+	}
+
+	const glm::vec2i A_FP = SnapToSubpixel(A_PS);
+	const glm::vec2i B_FP = SnapToSubpixel(B_PS);
+	const glm::vec2i C_FP = SnapToSubpixel(C_PS);
+
+	// Bounding Box
+	AABB2Di box;
+	box += A_FP;
+	box += B_FP;
+	box += C_FP;
+
+	PixelShadeDataPkg shadingData;
+	{
+		shadingData.A_PS = A_PS;
+		shadingData.B_PS = B_PS;
+		shadingData.C_PS = C_PS;
+
+		if(inTexture && inTexture->IsValid())
+		{
+			shadingData.Texture = inTexture;
+		}
+
+		shadingData.PipelineStateIdx = CurrentPipelineState;
+
+		// Depth is linear in screen space, so the nearest point of the triangle is one of its vertices
+		shadingData.NearestDepth = IsReversedZ(DepthFormat) ? glm::max(A_NDC.z, glm::max(B_NDC.z, C_NDC.z)) : glm::min(A_NDC.z, glm::min(B_NDC.z, C_NDC.z));
+	}
+
+	// Culling stage, all tests are done on the snapped coordinates so they agree exactly with what would be rasterized
+
+	// Edge functions, done once per triangle so that the pixel loop only has to step them
+	// E(x, y) = StepX * x + StepY * y + Origin is the signed double area of the triangle formed by the edge and P,
+	// divided by the full double area it gives the barycentric weight of the vertex opposite to the edge
+	float oneOverArea = 0.f;
+	{
+		const int64_t V0X = B_FP.x - A_FP.x;
+		const int64_t V0Y = B_FP.y - A_FP.y;
+		const int64_t V1X = C_FP.x - A_FP.x;
+		const int64_t V1Y = C_FP.y - A_FP.y;
+
+		int64_t det = V0X * V1Y - V1X * V0Y;
+		if (det == 0)
+		{
+			// Degenerate after snapping, covers nothing
+			++Stats.DegenerateCulled;
+			return;
+		}
+
+		if (IsCulledByWinding(static_cast<float>(det), CurrentCullMode))
+		{
+			++Stats.BackfaceCulled;
+
+			// Debug view keeps only the culled triangles
+			if (!bShowCulledTriangles)
+			{
+				return;
+			}
+
+			shadingData.PipelineStateIdx = CurrentCulledPipelineState;
+		}
+
+		// Make edges positive inside regardless of winding
+		const int64_t orientation = det > 0 ? 1 : -1;
+		det *= orientation;
+
+		EdgeFunction& edgeB = shadingData.EdgeB;
+		edgeB.StepX = static_cast<int32_t>(orientation * V1Y);
+		edgeB.StepY = static_cast<int32_t>(orientation * -V1X);
+		edgeB.Origin = orientation * (V1X * A_FP.y - V1Y * A_FP.x);
+
+		EdgeFunction& edgeC = shadingData.EdgeC;
+		edgeC.StepX = static_cast<int32_t>(orientation * -V0Y);
+		edgeC.StepY = static_cast<int32_t>(orientation * V0X);
+		edgeC.Origin = orientation * (V0Y * A_FP.x - V0X * A_FP.y);
+
+		// Weights sum up to the full area
+		EdgeFunction& edgeA = shadingData.EdgeA;
+		edgeA.StepX = -edgeB.StepX - edgeC.StepX;
+		edgeA.StepY = -edgeB.StepY - edgeC.StepY;
+		edgeA.Origin = det - edgeB.Origin - edgeC.Origin;
+
+		// Top-left fill rule, pixel centers exactly on an edge only belong to the triangle if it is a top or left edge
+		// so that pixels on edges shared by two triangles are covered exactly once.
+		// Pixel space is vertically flipped compared to the presented image, so top edges are the ones with the inside towards -Y here
+		// Non top-left edges are biased so that 0 becomes outside, coverage test stays E >= 0
+		for (EdgeFunction* edge : { &edgeA, &edgeB, &edgeC })
+		{
+			const bool bLeftEdge = edge->StepX > 0;
+			const bool bTopEdge = edge->StepX == 0 && edge->StepY < 0;
+
+			if (!bLeftEdge && !bTopEdge)
+			{
+				edge->Origin -= 1;
+			}
+		}
+
+		oneOverArea = 1.f / static_cast<float>(det);
+	}
+
+	// Clamp to screen, triangles fully outside of it have nothing to rasterize
+	// Only pixels whose center is inside the snapped bounding box can be covered
+	shadingData.PixelMinX = glm::max(0, (box.Min.x - SUBPIXEL_HALF + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS);
+	shadingData.PixelMinY = glm::max(0, (box.Min.y - SUBPIXEL_HALF + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS);
+	shadingData.PixelMaxX = glm::min(ImageWidth - 1, (box.Max.x - SUBPIXEL_HALF) >> SUBPIXEL_BITS);
+	shadingData.PixelMaxY = glm::min(ImageHeight - 1, (box.Max.y - SUBPIXEL_HALF) >> SUBPIXEL_BITS);
+
+	// Small triangles can fall between pixel centers, in which case they cover no samples
+	if (shadingData.PixelMinX > shadingData.PixelMaxX || shadingData.PixelMinY > shadingData.PixelMaxY)
+	{
+		++Stats.NoSamplesCulled;
+		return;
+	}
+
+	// Plane equations, anything linear in screen space is interpolated from the barycentrics of the pixel
+	// Barycentrics are the edge values over the area, edges step by StepX and StepY per sub-pixel
+	const float baryScale = SUBPIXEL_SCALE * oneOverArea;
+	const glm::vec3 baryDX = glm::vec3(shadingData.EdgeA.StepX, shadingData.EdgeB.StepX, shadingData.EdgeC.StepX) * baryScale;
+	const glm::vec3 baryDY = glm::vec3(shadingData.EdgeA.StepY, shadingData.EdgeB.StepY, shadingData.EdgeC.StepY) * baryScale;
+	const glm::vec3 baryOrigin = glm::vec3(
+		static_cast<float>(shadingData.EdgeA.EvaluatePixelCenter(shadingData.PixelMinX, shadingData.PixelMinY)),
+		static_cast<float>(shadingData.EdgeB.EvaluatePixelCenter(shadingData.PixelMinX, shadingData.PixelMinY)),
+		static_cast<float>(shadingData.EdgeC.EvaluatePixelCenter(shadingData.PixelMinX, shadingData.PixelMinY))) * oneOverArea;
+
+	const auto makePlane = [&](const glm::vec3& inVertexValues)
+		{
+			ScreenPlane plane;
+			plane.DDX = glm::dot(baryDX, inVertexValues);
+			plane.DDY = glm::dot(baryDY, inVertexValues);
+			plane.Origin = glm::dot(baryOrigin, inVertexValues);
+			return plane;
+		};
+
+	shadingData.Depth = makePlane(glm::vec3(A_NDC.z, B_NDC.z, C_NDC.z));
+
+	// Varyings over w and 1 over w are linear in screen space, pixels divide the first by the second
+	const uint16_t varyingMask = FramePipelineStates[shadingData.PipelineStateIdx].Key.VaryingMask;
+	if (varyingMask != 0)
+	{
+		const glm::vec3 oneOverW = 1.f / glm::vec3(A.ClipSpacePos.w, B.ClipSpacePos.w, C.ClipSpacePos.w);
+
+		shadingData.FirstVaryingPlane = static_cast<uint32_t>(VaryingPlanes.size());
+		VaryingPlanes.push_back(makePlane(oneOverW));
+		for (int32_t slot = 0; slot < Varying_Count; ++slot)
+		{
+			if (varyingMask & (1u << slot))
+			{
+				VaryingPlanes.push_back(makePlane(glm::vec3(A.Varyings[slot], B.Varyings[slot], C.Varyings[slot]) * oneOverW));
+			}
+		}
+	}
+
+	++Stats.TrianglesBinned;
+
+	// Bin the triangle in all tiles its bounding box touches
+	const uint32_t setupIdx = static_cast<uint32_t>(TriangleSetups.size());
+	shadingData.VisibilityId = setupIdx + 1;
+	TriangleSetups.push_back(shadingData);
+
+	const int32_t tileStartX = shadingData.PixelMinX / BIN_TILE_SIZE;
+	const int32_t tileStartY = shadingData.PixelMinY / BIN_TILE_SIZE;
+	const int32_t tileEndX = shadingData.PixelMaxX / BIN_TILE_SIZE;
+	const int32_t tileEndY = shadingData.PixelMaxY / BIN_TILE_SIZE;
+
+	for (int32_t tileY = tileStartY; tileY <= tileEndY; ++tileY)
+	{
+		for (int32_t tileX = tileStartX; tileX <= tileEndX; ++tileX)
+		{
+			TileBins[tileY * NumTilesX + tileX].push_back(setupIdx);
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterizeBinnedTriangles()
+{
+	if (TriangleSetups.empty())
+	{
+		return;
+	}
+
+	HiZCulledTriangles.store(0);
+	HiZCulledBlocks.store(0);
+
+	const auto startTime = std::chrono::high_resolution_clock::now();
+
+	// Tiles are split between the job system workers and this thread, which waits for all of them
+	const auto rasterizeTiles = [this](const int32_t inBegin, const int32_t inEnd)
+		{
+			RasterizeTiles(inBegin, inEnd);
+		};
+
+	if (bKeepTileAffinity)
+	{
+		JobSystem::Get().ParallelForWithAffinity(NumTotalTiles, 1, rasterizeTiles);
+	}
+	else
+	{
+		JobSystem::Get().ParallelFor(NumTotalTiles, 1, rasterizeTiles);
+	}
+
+	const auto endTime = std::chrono::high_resolution_clock::now();
+	Stats.TileRasterMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	Stats.NumRasterThreads = JobSystem::Get().GetNumActiveWorkers() + 1;
+
+	Stats.HiZCulledTriangles = HiZCulledTriangles.load();
+	Stats.HiZCulledBlocks = HiZCulledBlocks.load();
+
+	if (bDrawWireframe)
+	{
+		for (const PixelShadeDataPkg& setup : TriangleSetups)
+		{
+			DrawLine(setup.A_PS, setup.B_PS, glm::vec4(0.f, 1.f, 0.f, 1.f));
+			DrawLine(setup.B_PS, setup.C_PS, glm::vec4(1.f, 0.f, 0.f, 1.f));
+			DrawLine(setup.C_PS, setup.A_PS, glm::vec4(0.f, 0.f, 1.f, 1.f));
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterizeTiles(const int32_t inBeginTileIdx, const int32_t inEndTileIdx)
+{
+	for (int32_t tileIdx = inBeginTileIdx; tileIdx < inEndTileIdx; ++tileIdx)
+	{
+		RasterizeTile(tileIdx);
+	}
+}
+
+void SoftwareRasterizer::RasterizeTile(const int32_t inTileIdx)
+{
+	DispatchDepthFormat(DepthFormat, [this, inTileIdx](auto inDepthFormat)
+		{
+			DispatchColorFormat(ColorTargetFormat, [this, inTileIdx](auto inColorFormat)
+				{
+					RasterizeTile<decltype(inDepthFormat)::value, decltype(inColorFormat)::value>(inTileIdx);
+				});
+		});
+}
+
+template<EDepthFormat Format, EColorFormat ColorFormat>
+void SoftwareRasterizer::RasterizeTile(const int32_t inTileIdx)
+{
+	using DepthTraits = DepthFormatTraits<Format>;
+
+	// Untouched tiles stay cleared and are resolved at the end of the frame
+	if (TileBins[inTileIdx].empty())
+	{
+		return;
+	}
 
-	// = ax * by - ay * bx
+	if (TileCleared[inTileIdx])
+	{
+		ClearTile<Format, ColorFormat>(inTileIdx);
+	}
 
-	const int32_t det = A.x * B.y - A.y * B.x;
+	const int32_t tileMinX = (inTileIdx % NumTilesX) * BIN_TILE_SIZE;
+	const int32_t tileMinY = (inTileIdx / NumTilesX) * BIN_TILE_SIZE;
+	const int32_t tileMaxX = glm::min(tileMinX + BIN_TILE_SIZE, ImageWidth) - 1;
+	const int32_t tileMaxY = glm::min(tileMinY + BIN_TILE_SIZE, ImageHeight) - 1;
 
-	return det;
-}
+	// Hi-Z, triangles whose nearest depth is behind everything in the tile can not pass the depth test anywhere in it
+	// The reference rasterizer keeps testing every pixel
+	const bool bUseHiZ = bDepthTestEnabled && !bReferenceRasterizer;
+	float tileFarthestDepth = bUseHiZ ? GetHiZFarthestDepth<Format>(tileMinX, tileMinY, tileMaxX, tileMaxY) : 0.f;
+	int32_t hiZCulledTriangles = 0;
+	int32_t hiZCulledBlocks = 0;
 
-int32_t countTriangles = 0;
+	// Triangles are in submission order, so depth ties resolve the same way as when drawing serially
+	for (const uint32_t setupIdx : TileBins[inTileIdx])
+	{
+		const PixelShadeDataPkg& shadingData = TriangleSetups[setupIdx];
 
-void SoftwareRasterizer::DrawChildren(const eastl::vector<TransformObjPtr>& inChildren, const glm::mat4& inProj, const glm::mat4& inView, const eastl::vector<MeshMaterial>& inMaterials)
-{
-	for (uint32_t i = 0; i < inChildren.size(); ++i)
+		const int32_t pixelMinX = glm::max(shadingData.PixelMinX, tileMinX);
+		const int32_t pixelMinY = glm::max(shadingData.PixelMinY, tileMinY);
+		const int32_t pixelMaxX = glm::min(shadingData.PixelMaxX, tileMaxX);
+		const int32_t pixelMaxY = glm::min(shadingData.PixelMaxY, tileMaxY);
+
+		if (bUseHiZ && !DepthTraits::IsNearer(GetNearestDepthKey<DepthTraits>(shadingData.NearestDepth), tileFarthestDepth))
+		{
+			++hiZCulledTriangles;
+			continue;
+		}
+
+		// Kernels of the triangle's pipeline state, picked when its draw started
+		const FramePipelineState& pipelineState = FramePipelineStates[shadingData.PipelineStateIdx];
+		if ((this->*pipelineState.Rasterize)(shadingData, pipelineState.Key, pixelMinX, pixelMinY, pixelMaxX, pixelMaxY, hiZCulledBlocks) && bUseHiZ)
+		{
+			tileFarthestDepth = GetHiZFarthestDepth<Format>(tileMinX, tileMinY, tileMaxX, tileMaxY);
+		}
+	}
+
+	// Second pass, the tile's depth and ids are final so every visible pixel is shaded exactly once
+	if (bVisibilityBufferEnabled)
 	{
-		const TransformObjPtr& currChild = inChildren[i];
-		DrawChildren(currChild->GetChildren(), inProj, inView, inMaterials);
+		ShadeVisibilityTile<ColorFormat>(tileMinX, tileMinY, tileMaxX, tileMaxY);
+	}
+
+	if (hiZCulledTriangles > 0)
+	{
+		HiZCulledTriangles.fetch_add(hiZCulledTriangles);
+	}
+	if (hiZCulledBlocks > 0)
+	{
+		HiZCulledBlocks.fetch_add(hiZCulledBlocks);
+	}
+}
 
-		const eastl::shared_ptr<MeshNode> node = eastl::dynamic_shared_pointer_cast<MeshNode>(currChild);
-		if (node)
+template<typename State>
+bool SoftwareRasterizer::RasterizeTriangle(const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey, const int32_t inMinX, const int32_t inMinY, const int32_t inMaxX, const int32_t inMaxY, int32_t& ioHiZCulledBlocks)
+{
+	if (bReferenceRasterizer)
+	{
+		for (int32_t i = inMinY; i <= inMaxY; ++i)
 		{
-			const DirectX::Image* usedImage = nullptr;
-			if (node->MatIndex != uint32_t(-1))
+			for (int32_t j = inMinX; j <= inMaxX; ++j)
 			{
-				const MeshMaterial& currMaterial = inMaterials[node->MatIndex];
-				const eastl::shared_ptr<D3D12Texture2D>& currTex = currMaterial.AlbedoMap;
-				const DirectX::ScratchImage& dxImage = currTex->CPUImage;
-				usedImage = &dxImage.GetImages()[0];
+				ShadePixel<State>(j, i, inPixelData, inKey);
 			}
+		}
 
-			const eastl::vector<SimpleVertex> CPUVertices = node->CPUVertices;
-			const eastl::vector<uint32_t> CPUIndices = node->CPUIndices;
+		return false;
+	}
 
-			const uint32_t numIndices = static_cast<uint32_t>(CPUIndices.size());
-			ASSERT(numIndices % 3 == 0);
-			const uint32_t numTriangles = numIndices / 3;
+	if (bSIMDRasterizer)
+	{
+		return RasterizeTriangleSIMD<State>(inPixelData, inKey, inMinX, inMinY, inMaxX, inMaxY, ioHiZCulledBlocks);
+	}
 
-			// Draw triangle by triangle
-			for (uint32_t triangleIdx = 0; triangleIdx < numTriangles; ++triangleIdx)
-			{
-				if (countTriangles >= maxTriangles)
-				{
-					//return;
-				}
+	const EdgeFunction& edgeA = inPixelData.EdgeA;
+	const EdgeFunction& edgeB = inPixelData.EdgeB;
+	const EdgeFunction& edgeC = inPixelData.EdgeC;
+
+	// Evaluate at the center of the first pixel of the first row
+	int64_t rowA = edgeA.EvaluatePixelCenter(inMinX, inMinY);
+	int64_t rowB = edgeB.EvaluatePixelCenter(inMinX, inMinY);
+	int64_t rowC = edgeC.EvaluatePixelCenter(inMinX, inMinY);
+
+	// One pixel is SUBPIXEL_SCALE sub-pixels
+	const int64_t pixelStepXA = int64_t(edgeA.StepX) * SUBPIXEL_SCALE;
+	const int64_t pixelStepXB = int64_t(edgeB.StepX) * SUBPIXEL_SCALE;
+	const int64_t pixelStepXC = int64_t(edgeC.StepX) * SUBPIXEL_SCALE;
+	const int64_t pixelStepYA = int64_t(edgeA.StepY) * SUBPIXEL_SCALE;
+	const int64_t pixelStepYB = int64_t(edgeB.StepY) * SUBPIXEL_SCALE;
+	const int64_t pixelStepYC = int64_t(edgeC.StepY) * SUBPIXEL_SCALE;
+
+	bool bAnyCovered = false;
+	for (int32_t i = inMinY; i <= inMaxY; ++i)
+	{
+		int64_t eA = rowA;
+		int64_t eB = rowB;
+		int64_t eC = rowC;
+		bool bWasInside = false;
 
-				const uint32_t idxStart = triangleIdx * 3;
+		for (int32_t j = inMinX; j <= inMaxX; ++j)
+		{
+			if ((eA | eB | eC) >= 0)
+			{
+				bWasInside = true;
+				bAnyCovered = true;
+				ShadeCoveredPixel<State>(j, i, inPixelData, inKey);
+			}
+			else if (bWasInside)
+			{
+				// Triangles are convex, nothing left on this row once we are out
+				break;
+			}
 
-				// Vtx Shader
-				// Outputs clip space
-				{
-					const SimpleVertex& vtxA = CPUVertices[CPUIndices[idxStart]];
-					const SimpleVertex& vtxB = CPUVertices[CPUIndices[idxStart + 1]];
-					const SimpleVertex& vtxC = CPUVertices[CPUIndices[idxStart + 2]];
+			eA += pixelStepXA;
+			eB += pixelStepXB;
+			eC += pixelStepXC;
+		}
 
-					const glm::vec3 vtxAPos = vtxA.Position;
-					const glm::vec3 vtxBPos = vtxB.Position;
-					const glm::vec3 vtxCPos = vtxC.Position;
+		rowA += pixelStepYA;
+		rowB += pixelStepYB;
+		rowC += pixelStepYC;
+	}
 
-					const Transform& modelTrans = currChild->GetAbsoluteTransform();
-					const glm::mat4 absoluteMat = modelTrans.GetMatrix();
+	if (!bAnyCovered || !State::HasFlag(inKey, Ps_DepthTest))
+	{
+		return false;
+	}
 
-					const glm::mat4 worldToClip = inProj * inView * absoluteMat;
-					//const glm::mat4 worldToClip = glm::mat4(1.f);
+	for (int32_t blockY = inMinY / HIZ_BLOCK_SIZE; blockY <= inMaxY / HIZ_BLOCK_SIZE; ++blockY)
+	{
+		for (int32_t blockX = inMinX / HIZ_BLOCK_SIZE; blockX <= inMaxX / HIZ_BLOCK_SIZE; ++blockX)
+		{
+			UpdateHiZBlock<State::DepthFormat>(blockX, blockY);
+		}
+	}
 
-					const glm::vec4 vtxAClipsSpace = TransformPosition(vtxAPos, worldToClip);
-					const glm::vec4 vtxBClipSpace = TransformPosition(vtxBPos, worldToClip);
-					const glm::vec4 vtxCClipSpace = TransformPosition(vtxCPos, worldToClip);
+	return true;
+}
 
-					//const glm::vec3 viewDir = currentScene.GetCurrentCamera()->GetViewDir();
-					const glm::vec3 viewDir = inView[2]; // Z axis of rotation
+template<EColorFormat ColorFormat>
+void SoftwareRasterizer::ShadeVisibilityTile(const int32_t inMinX, const int32_t inMinY, const int32_t inMaxX, const int32_t inMaxY)
+{
+	using ColorTraits = ColorFormatTraits<ColorFormat>;
+	typename ColorTraits::StorageType* colorData = reinterpret_cast<typename ColorTraits::StorageType*>(ColorTarget);
 
-					DrawTriangle({ vtxAClipsSpace, vtxA.Normal, vtxA.TexCoords }, { vtxBClipSpace, vtxB.Normal, vtxB.TexCoords }, { vtxCClipSpace, vtxC.Normal, vtxC.TexCoords }, usedImage);
-				}
-				++countTriangles;
+	for (int32_t y = inMinY; y <= inMaxY; ++y)
+	{
+		for (int32_t x = inMinX; x <= inMaxX; ++x)
+		{
+			const int32_t pixelPos = GetPixelPos(x, y);
+			const uint32_t visibilityId = VisibilityData[pixelPos];
+			if (visibilityId == 0)
+			{
+				continue;
+			}
 
+			// Shade kernel of the triangle's pipeline state, states writing no color have none
+			const PixelShadeDataPkg& shadingData = TriangleSetups[visibilityId - 1];
+			const FramePipelineState& pipelineState = FramePipelineStates[shadingData.PipelineStateIdx];
+			uint32_t RGBA = 0;
+			if (pipelineState.Shade && (this->*pipelineState.Shade)(x, y, shadingData, pipelineState.Key, RGBA))
+			{
+				ColorTraits::Store(&colorData[pixelPos], RGBA);
 			}
 		}
+	}
+}
+
+template<EDepthFormat Format>
+void SoftwareRasterizer::UpdateHiZBlock(const int32_t inBlockX, const int32_t inBlockY)
+{
+	using namespace SIMD;
+	using DepthTraits = DepthFormatTraits<Format>;
+	const typename DepthTraits::StorageType* depthData = reinterpret_cast<const typename DepthTraits::StorageType*>(DepthData);
+
+	const int32_t startX = inBlockX * HIZ_BLOCK_SIZE;
+	const int32_t startY = inBlockY * HIZ_BLOCK_SIZE;
+	const int32_t endX = glm::min(startX + HIZ_BLOCK_SIZE, ImageWidth);
+	const int32_t endY = glm::min(startY + HIZ_BLOCK_SIZE, ImageHeight);
+
+	// Padding past the image edge is not part of the block's depth
+	const typename DepthTraits::StorageType* blockDepth = &depthData[(inBlockY * NumBlocksX + inBlockX) * RASTER_BLOCK_PIXELS];
+	float farthestDepth = DepthTraits::NearestKey;
+	if (endX - startX == Width)
+	{
+		Float8 rowFarthest = DepthTraits::Load8(blockDepth);
+		for (int32_t y = 1; y < endY - startY; ++y)
+		{
+			rowFarthest = DepthTraits::Farthest(rowFarthest, DepthTraits::Load8(&blockDepth[y * RASTER_BLOCK_SIZE]));
+		}
 
+		farthestDepth = DepthTraits::ReduceFarthest(rowFarthest);
+	}
+	else
+	{
+		for (int32_t y = 0; y < endY - startY; ++y)
+		{
+			for (int32_t x = 0; x < endX - startX; ++x)
+			{
+				farthestDepth = DepthTraits::Farthest(farthestDepth, DepthTraits::Load(&blockDepth[y * RASTER_BLOCK_SIZE + x]));
+			}
+		}
 	}
 
+	HiZData[inBlockY * HiZWidth + inBlockX] = farthestDepth;
 }
 
-void SoftwareRasterizer::DrawModel(const eastl::shared_ptr<Model3D>& inModel)
+template<EDepthFormat Format>
+float SoftwareRasterizer::GetHiZFarthestDepth(const int32_t inMinX, const int32_t inMinY, const int32_t inMaxX, const int32_t inMaxY) const
 {
-	countTriangles = 0;
+	using DepthTraits = DepthFormatTraits<Format>;
 
-	const float orthoAABBHalfLength = 5.f;
-	//const glm::mat4 projection = glm::orthoLH_ZO(-orthoAABBHalfLength, orthoAABBHalfLength, -orthoAABBHalfLength, orthoAABBHalfLength, 0.f, orthoAABBHalfLength * 2);
-	const glm::mat4 projection = glm::perspectiveLH_ZO(glm::radians(CAMERA_FOV), static_cast<float>(ImageWidth) / static_cast<float>(ImageHeight), CAMERA_NEAR, CAMERA_FAR);
+	float farthestDepth = DepthTraits::NearestKey;
+	for (int32_t blockY = inMinY / HIZ_BLOCK_SIZE; blockY <= inMaxY / HIZ_BLOCK_SIZE; ++blockY)
+	{
+		for (int32_t blockX = inMinX / HIZ_BLOCK_SIZE; blockX <= inMaxX / HIZ_BLOCK_SIZE; ++blockX)
+		{
+			farthestDepth = DepthTraits::Farthest(farthestDepth, HiZData[blockY * HiZWidth + blockX]);
+		}
+	}
 
-	SceneManager& sManager = SceneManager::Get();
-	const Scene& currentScene = sManager.GetCurrentScene();
-	const glm::mat4 view = currentScene.GetMainCameraLookAt();
+	return farthestDepth;
+}
 
-	const eastl::vector<MeshMaterial>& materials = inModel->Materials;
-	const eastl::vector<TransformObjPtr>& modelChildren = inModel->GetChildren();
+// Screen plane broadcast for the SIMD pixel loop
+struct SIMDScreenPlane
+{
+	SIMD::Float8 DDX;
+	SIMD::Float8 DDY;
+	SIMD::Float8 Origin;
 
-	DrawChildren(inModel->GetChildren(), projection, view, materials);
-}
+	inline void Set(const ScreenPlane& inPlane)
+	{
+		DDX = SIMD::Set1(inPlane.DDX);
+		DDY = SIMD::Set1(inPlane.DDY);
+		Origin = SIMD::Set1(inPlane.Origin);
+	}
 
+	// Same operations as ScreenPlane::Evaluate, so both paths get the same values
+	inline SIMD::Float8 Evaluate(const SIMD::Float8& inX, const SIMD::Float8& inY) const
+	{
+		return DDX * inX + DDY * inY + Origin;
+	}
+};
 
-void SoftwareRasterizer::DrawTriangle(const VtxShaderOutput& A, const VtxShaderOutput& B, const VtxShaderOutput& C, const DirectX::Image* CPUImage)
+// Per triangle values broadcast once for the SIMD pixel loop
+struct SIMDTriangleInterpolants
 {
-	const glm::vec3 A_NDC = HomDivide(A.ClipSpacePos);
-	const glm::vec3 B_NDC = HomDivide(B.ClipSpacePos);
-	const glm::vec3 C_NDC = HomDivide(C.ClipSpacePos);
+	SIMDScreenPlane Depth;
 
-	// Clip based on clip space coords defined by projection matrix
-	// TODO: This should split the triangle up when it is only partially in the clip space
-	//if (A_NDC.z < 0.f || A_NDC.z > 1.f || B_NDC.z < 0.f || B_NDC.z > 1.f || C_NDC.z < 0.f || C_NDC.z > 1.f)
-	//{
-	//	return;
-	//}
-
-	bool bCulled = false;
-	// Backface cull the triangle
-	//{
-	//	const glm::vec3 v0 = A_NDC;
-	//	const glm::vec3 v1 = B_NDC;
-	//	const glm::vec3 v2 = C_NDC;
-
-	//	const glm::vec3 v0v1 = v1 - v0;
-	//	const glm::vec3 v0v2 = v2 - v0;
-
-	//	// LH CCW culling
-	//	const glm::vec3 trianglePlaneNormal = glm::normalize(glm::cross(v0v1, v0v2));
-
-	//	// CW
-	//	//const glm::vec3 trianglePlaneNormal = glm::normalize(glm::cross(v0v2, v0v1));
-	//	
-	//	//LOG_INFO("Triangle normal is %.2f, %.2f, %.2f", trianglePlaneNormal.x, trianglePlaneNormal.y, trianglePlaneNormal.z);
-
-	//	const float dot = glm::dot(trianglePlaneNormal, glm::vec3(0.f, 0.f, 1.f));
-	//	// dot for dir from cam to vertex with triangle normal, dir cam to vert is v0 - camLoc, camLoc is origin (0,0,0) in viewSpace, so just v0
-	//	//const float dot = glm::dot(trianglePlaneNormal, v0);
-
-	//	//LOG_INFO("Dot product is %.2f", dot);
-
-	//	// Triangle is visible only when normal is pointing towards camera, so opposite of camera dir
-	//	if (dot >= 0.f)
-	//	{
-	//		// Skip triangle
-	//		bCulled = true;
-	//		if (!bDrawOnlyBackfaceCulled)
-	//		{
-	//			return;
-	//		}
-	//	}
-	//}
+	// Only set up for textured pipeline states
+	TexCoordPlanes TexCoords;
+	SIMDScreenPlane OneOverW;
+	SIMDScreenPlane UOverW;
+	SIMDScreenPlane VOverW;
+};
 
-	// Map from -1..1 to 0..1 (Screen Space)
-	const glm::vec3 vtxAScreenSpace = (A_NDC + 1.f) / 2.f;
-	const glm::vec3 vtxBScreenSpace = (B_NDC + 1.f) / 2.f;
-	const glm::vec3 vtxCScreenSpace = (C_NDC + 1.f) / 2.f;
+template<typename State>
+bool SoftwareRasterizer::RasterizeTriangleSIMD(const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey, const int32_t inMinX, const int32_t inMinY, const int32_t inMaxX, const int32_t inMaxY, int32_t& ioHiZCulledBlocks)
+{
+	using namespace SIMD;
+	using DepthTraits = DepthFormatTraits<State::DepthFormat>;
+	const bool bDepthTest = State::HasFlag(inKey, Ps_DepthTest);
 
-	// Map to pixel space
-	const glm::vec2 A_PS(vtxAScreenSpace.x * (ImageWidth - 1), vtxAScreenSpace.y * (ImageHeight - 1));
-	const glm::vec2 B_PS(vtxBScreenSpace.x * (ImageWidth - 1), vtxBScreenSpace.y * (ImageHeight - 1));
-	const glm::vec2 C_PS(vtxCScreenSpace.x * (ImageWidth - 1), vtxCScreenSpace.y * (ImageHeight - 1));
+	SIMDTriangleInterpolants interpolants;
+	interpolants.Depth.Set(inPixelData.Depth);
 
-	if (bDrawTriangleWireframe)
+	if (State::HasFlag(inKey, Ps_Textured))
 	{
-		DrawLine(A_PS, B_PS, glm::vec4(0.f, 1.f, 0.f, 1.f));
-		DrawLine(B_PS, C_PS, glm::vec4(1.f, 0.f, 0.f, 1.f));
-		DrawLine(C_PS, A_PS, glm::vec4(0.f, 0.f, 1.f, 1.f));
+		interpolants.TexCoords = GetTexCoordPlanes<State>(VaryingPlanes, inPixelData, inKey);
+		interpolants.OneOverW.Set(*interpolants.TexCoords.OneOverW);
+		interpolants.UOverW.Set(*interpolants.TexCoords.UOverW);
+		interpolants.VOverW.Set(*interpolants.TexCoords.VOverW);
 	}
 
+	const EdgeFunction* edges[3] = { &inPixelData.EdgeA, &inPixelData.EdgeB, &inPixelData.EdgeC };
 
-	// Bounding Box
-	// draw inside of it and check if pixel is in using cross product method but for 2d vectors
-	// might also be possible to check using barycentric coordinates, need to check
+	// Offsets from the first to the last pixel center of a block, in sub-pixels
+	constexpr int64_t blockCenterSpan = int64_t(RASTER_BLOCK_SIZE - 1) << SUBPIXEL_BITS;
+
+	// Per edge values stepped across and down a block
+	// Corner offsets give the minimum and maximum of each edge over a block, edges being linear these are always at block corners
+	int64_t edgeMinOffset[3];
+	int64_t edgeMaxOffset[3];
+	int64_t pixelStepY[3];
+	Int8 laneOffsets[3];
+	for (int32_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+	{
+		const EdgeFunction& edge = *edges[edgeIdx];
+		edgeMinOffset[edgeIdx] = (glm::min<int64_t>(edge.StepX, 0) + glm::min<int64_t>(edge.StepY, 0)) * blockCenterSpan;
+		edgeMaxOffset[edgeIdx] = (glm::max<int64_t>(edge.StepX, 0) + glm::max<int64_t>(edge.StepY, 0)) * blockCenterSpan;
+		pixelStepY[edgeIdx] = int64_t(edge.StepY) * SUBPIXEL_SCALE;
 
-	AABB2D box;
-	box += A_PS;
-	box += B_PS;
-	box += C_PS;
+		alignas(32) int32_t edgeLaneOffsets[Width];
+		for (int32_t lane = 0; lane < Width; ++lane)
+		{
+			edgeLaneOffsets[lane] = edge.StepX * lane * SUBPIXEL_SCALE;
+		}
 
-	const glm::vec2& min = box.Min;
-	const glm::vec2& max = box.Max;
+		laneOffsets[edgeIdx] = LoadU(reinterpret_cast<const uint32_t*>(edgeLaneOffsets));
+	}
 
-	const glm::vec2 AB = B_PS - A_PS;
-	const glm::vec2 BC = C_PS - B_PS;
-	const glm::vec2 CA = A_PS - C_PS;
+	// Blocks are aligned so that they never straddle two tiles
+	const int32_t blockStartX = inMinX & ~(RASTER_BLOCK_SIZE - 1);
+	const int32_t blockStartY = inMinY & ~(RASTER_BLOCK_SIZE - 1);
 
-	PixelShadeDataPkg shadingData;
+	const float nearestDepthKey = GetNearestDepthKey<DepthTraits>(inPixelData.NearestDepth);
+	bool bAnyDepthWritten = false;
+
+	for (int32_t blockY = blockStartY; blockY <= inMaxY; blockY += RASTER_BLOCK_SIZE)
 	{
-		shadingData.A = A;
-		shadingData.B = B;
-		shadingData.C = C;
+		for (int32_t blockX = blockStartX; blockX <= inMaxX; blockX += RASTER_BLOCK_SIZE)
+		{
+			// Trivial reject when the block is fully outside of any edge, trivial accept when it is inside of all of them
+			int64_t blockOriginValue[3];
+			bool bEdgeFullyInside[3];
+			bool bFullyOutside = false;
+			for (int32_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+			{
+				blockOriginValue[edgeIdx] = edges[edgeIdx]->EvaluatePixelCenter(blockX, blockY);
+				bFullyOutside |= blockOriginValue[edgeIdx] + edgeMaxOffset[edgeIdx] < 0;
+				bEdgeFullyInside[edgeIdx] = blockOriginValue[edgeIdx] + edgeMinOffset[edgeIdx] >= 0;
+			}
 
-		shadingData.A_NDC = A_NDC;
-		shadingData.B_NDC = B_NDC;
-		shadingData.C_NDC = C_NDC;
+			if (bFullyOutside)
+			{
+				continue;
+			}
 
-		shadingData.A_PS = A_PS;
-		shadingData.B_PS = B_PS;
-		shadingData.C_PS = C_PS;
+			// Every pixel of the block is already nearer than anything this triangle can write
+			const float blockFarthestDepth = HiZData[(blockY / HIZ_BLOCK_SIZE) * HiZWidth + blockX / HIZ_BLOCK_SIZE];
+			if (bDepthTest && !DepthTraits::IsNearer(nearestDepthKey, blockFarthestDepth))
+			{
+				++ioHiZCulledBlocks;
+				continue;
+			}
 
-		shadingData.vtxAScreenSpace = vtxAScreenSpace;
-		shadingData.vtxBScreenSpace = vtxBScreenSpace;
-		shadingData.vtxCScreenSpace = vtxCScreenSpace;
+			bool bBlockDepthWritten = false;
 
-		if(CPUImage)
-		{
-			shadingData.TexPixels = CPUImage->pixels;
-			shadingData.TexWidth = CPUImage->width;
-			shadingData.TexHeight = CPUImage->height;
-			shadingData.bHasTexture = true;
-		}
-		else
-		{
-			shadingData.bHasTexture = false;
-		}
+			// Lanes outside of the tile's part of the bounding box are never written
+			uint32_t validBits = 0xffu;
+			if (blockX < inMinX)
+			{
+				validBits &= 0xffu << (inMinX - blockX);
+			}
+			if (blockX + RASTER_BLOCK_SIZE - 1 > inMaxX)
+			{
+				validBits &= 0xffu >> (blockX + RASTER_BLOCK_SIZE - 1 - inMaxX);
+			}
 
-		shadingData.bCulled = false;
-	}
+			const int32_t rowStart = glm::max(blockY, inMinY);
+			const int32_t rowEnd = glm::min(blockY + RASTER_BLOCK_SIZE - 1, inMaxY);
 
+			for (int32_t y = rowStart; y <= rowEnd; ++y)
+			{
+				int64_t rowValue[3];
+				for (int32_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+				{
+					rowValue[edgeIdx] = blockOriginValue[edgeIdx] + pixelStepY[edgeIdx] * (y - blockY);
+				}
 
-	const int32_t pixelMinY = glm::max(0, static_cast<int32_t>(min.y));
-	const int32_t pixelMinX = glm::max(0, static_cast<int32_t>(min.x));
-	const int32_t pixelMaxY = static_cast<int32_t>(max.y);
-	const int32_t pixelMaxX = static_cast<int32_t>(max.x);
+				uint32_t coverageBits = validBits;
 
-	const int32_t sizeY = glm::abs(pixelMaxY - pixelMinY);
-	const int32_t sizeX = glm::abs(pixelMaxX - pixelMinX);
+				// Only edges crossing the block need testing, their values inside the block fit in 32 bits
+				// Outside lanes are the ones with the sign bit set
+				Int8 outside = Set1Int(0);
+				for (int32_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+				{
+					if (!bEdgeFullyInside[edgeIdx])
+					{
+						outside = Or(outside, Set1Int(static_cast<int32_t>(rowValue[edgeIdx])) + laneOffsets[edgeIdx]);
+					}
+				}
 
-#define USE_MT 0
+				coverageBits &= ~MoveMask(outside);
+				if (coverageBits == 0)
+				{
+					continue;
+				}
 
-#if USE_MT
-	static bool firstTime = true;
+				// Blocks hanging over the right side of the image are whole in the targets, their outside lanes are not covered
+				bBlockDepthWritten |= ShadeBlockSIMD<State>(blockX, y, coverageBits, interpolants, inPixelData, inKey);
+			}
 
-	if (firstTime)
-	{
-		firstTime = false;
-		s_Paused.store(false);
+			if (bBlockDepthWritten && bDepthTest)
+			{
+				UpdateHiZBlock<State::DepthFormat>(blockX / HIZ_BLOCK_SIZE, blockY / HIZ_BLOCK_SIZE);
+				bAnyDepthWritten = true;
+			}
+		}
 	}
-	else
+
+	return bAnyDepthWritten;
+}
+
+template<typename State>
+bool SoftwareRasterizer::ShadeBlockSIMD(const int32_t inX, const int32_t inY, const uint32_t inCoverageBits, const SIMDTriangleInterpolants& inInterpolants, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey)
+{
+	using namespace SIMD;
+	using DepthTraits = DepthFormatTraits<State::DepthFormat>;
+	const bool bDepthTest = State::HasFlag(inKey, Ps_DepthTest);
+	const bool bLateZ = State::HasFlag(inKey, Ps_LateZ);
+	const bool bTextured = State::HasFlag(inKey, Ps_Textured);
+	const bool bColorWrite = State::HasFlag(inKey, Ps_ColorWrite);
+
+	// Planes are relative to the triangle's min corner
+	const Float8 planeX = Set1(static_cast<float>(inX - inPixelData.PixelMinX)) + Ramp();
+	const Float8 planeY = Set1(static_cast<float>(inY - inPixelData.PixelMinY));
+
+	const Float8 ndcDepth = inInterpolants.Depth.Evaluate(planeX, planeY);
+
+	Float8 mask = And(MaskFromBits(inCoverageBits), And(CmpGT(ndcDepth, Set1(0.f)), CmpLE(ndcDepth, Set1(1.f))));
+
+	// Early Z, see ShadeCoveredPixel
+	const Float8 depthKey = DepthTraits::ToKey(ndcDepth);
+	const int32_t pixelPos = GetPixelPos(inX, inY);
+	// There is no depth target without depth test
+	typename DepthTraits::StorageType* depthPtr = bDepthTest ? &reinterpret_cast<typename DepthTraits::StorageType*>(DepthData)[pixelPos] : nullptr;
+	if (bDepthTest && !bLateZ)
 	{
-		//s_EndBarrier.Wait();
+		const Float8 existingDepth = DepthTraits::Load8(depthPtr);
+		mask = And(mask, DepthTraits::IsNearer(depthKey, existingDepth));
+		DepthTraits::Store8(depthPtr, Select(mask, depthKey, existingDepth));
 	}
 
-	s_PixelShadeData = shadingData;
-	s_pixelMinX = pixelMinX;
-	s_pixelMinY = pixelMinY;
-	s_pixelMaxX = pixelMaxX;
-	s_pixelMaxY = pixelMaxY;
+	uint32_t shadeBits = MoveMask(mask);
+	if (shadeBits == 0)
+	{
+		return false;
+	}
 
-	const int32_t quadStartX = (pixelMinX / PIXEL_QUAD_LENGTH);
-	const int32_t quadStartY = (pixelMinY / PIXEL_QUAD_LENGTH);
-	const int32_t quadsEndX = (pixelMaxX / PIXEL_QUAD_LENGTH);
-	const int32_t quadsEndY = (pixelMaxY / PIXEL_QUAD_LENGTH);
+	bool bDepthWritten = bDepthTest && !bLateZ;
 
-	s_StartQuadIdx = quadStartY * s_NumQuadsPerImageRow + quadStartX;
-	s_EndQuadIdx = quadsEndY * s_NumQuadsPerImageRow + quadsEndX;
-	s_NumTotalQuadsCurrRun = s_EndQuadIdx - s_StartQuadIdx;
+	if (State::HasFlag(inKey, Ps_VisibilityBuffer))
+	{
+		uint32_t* visibilityPtr = &VisibilityData[pixelPos];
+		StoreU(visibilityPtr, Select(mask, Set1Int(static_cast<int32_t>(inPixelData.VisibilityId)), LoadU(visibilityPtr)));
 
-	// TODO:
-	// Has issues on models with big number of triangles. Fixing is required
-	// Cannot wait on it and block main thread.
-	// Have to put rasterizer on separate thread and just trigger and render after which the main thread checks if it is done and updates the image on screen only when it has finished and the new one is ready
-	// Is slow when many triangles are used, perf has to be increased
+		return bDepthWritten;
+	}
 
-	s_CurrAvailableQuad.store(s_StartQuadIdx);
+	alignas(32) uint32_t colors[Width];
+	if (bTextured && (bColorWrite || bLateZ))
+	{
+		// Perspective correct texcoords, see ShadeFragment
+		const Float8 pixelCameraSpaceDepth = Set1(1.f) / inInterpolants.OneOverW.Evaluate(planeX, planeY);
+		const Float8 texCoordU = inInterpolants.UOverW.Evaluate(planeX, planeY) * pixelCameraSpaceDepth;
+		const Float8 texCoordV = Set1(1.f) - inInterpolants.VOverW.Evaluate(planeX, planeY) * pixelCameraSpaceDepth;
+
+		alignas(32) float texCoordsU[Width];
+		alignas(32) float texCoordsV[Width];
+		StoreU(texCoordsU, texCoordU);
+		StoreU(texCoordsV, texCoordV);
+
+		// Texture fetches are gathers, do them per lane
+		for (int32_t lane = 0; lane < Width; ++lane)
+		{
+			if ((shadeBits & (1u << lane)) == 0)
+			{
+				continue;
+			}
 
-	// Trigger all threads
-	s_StartBarrier.Wait();
+			if (!SampleTexture(inPixelData, inInterpolants.TexCoords, glm::vec2(texCoordsU[lane], texCoordsV[lane]), State::GetTextureFilter(inKey), inX + lane, inY, colors[lane]))
+			{
+				// Discard
+				shadeBits &= ~(1u << lane);
+			}
+		}
+	}
+	else if (bColorWrite)
+	{
+		StoreU(colors, Set1Int(static_cast<int32_t>(inKey.FlatColor)));
+	}
 
-	// Wait for all threads to finish. Not ideal, should allow main thread to do it thing while threads are shading
-	s_EndBarrier.Wait();
+	// Late Z, only lanes that were not discarded are tested and write depth
+	if (bDepthTest && bLateZ && shadeBits != 0)
+	{
+		const Float8 existingDepth = DepthTraits::Load8(depthPtr);
+		const Float8 passed = And(MaskFromBits(shadeBits), DepthTraits::IsNearer(depthKey, existingDepth));
+		DepthTraits::Store8(depthPtr, Select(passed, depthKey, existingDepth));
 
-#else
+		shadeBits = MoveMask(passed);
+		bDepthWritten = shadeBits != 0;
+	}
 
-	for (int32_t i = pixelMinY; i <= pixelMaxY; ++i)
+	if (!bColorWrite || shadeBits == 0)
 	{
-		for (int32_t j = pixelMinX; j <= pixelMaxX; ++j)
-		{
-			ShadePixel(j, i, shadingData);
-		}
+		return bDepthWritten;
 	}
-#endif
 
+	using ColorTraits = ColorFormatTraits<State::ColorFormat>;
+	ColorTraits::Store8(&reinterpret_cast<typename ColorTraits::StorageType*>(ColorTarget)[pixelPos], colors, shadeBits);
 
+	return bDepthWritten;
 }
 
-void SoftwareRasterizer::ShadePixel(const int32_t inX, const int32_t inY, const PixelShadeDataPkg& inPixelData)
+template<typename State>
+void SoftwareRasterizer::ShadePixel(const int32_t inX, const int32_t inY, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey)
 {
-	int32_t pixelPos = 0;
-	if (!TryGetPixelPos(inX, inY, pixelPos))
+	if (inX < 0 || inY < 0 || inX >= ImageWidth || inY >= ImageHeight)
 	{
 		return;
 	}
@@ -798,52 +2622,40 @@ void SoftwareRasterizer::ShadePixel(const int32_t inX, const int32_t inY, const
 		return;
 	}
 
-	// x, y, z can be linearly interpolated in screen space using screen space derived barycentrics.
-	// However, nothing that's in camera space can be derived using just the screen space derived barycentrics
-	// For that we need the camera space z.
-
-	const float ndcDepth = (wA * inPixelData.A_NDC.z) + (wB * inPixelData.B_NDC.z) + (wC * inPixelData.C_NDC.z);
-	const float pixelCameraSpaceDepth = 1.f / ((wA / inPixelData.A.ClipSpacePos.w) + (wB / inPixelData.B.ClipSpacePos.w) + (wC / inPixelData.C.ClipSpacePos.w)); // Depth in camera space, 
-	// we need this because this for everything else because this is what gets used to do the perspective divide
-
-
+	ShadeCoveredPixel<State>(inX, inY, inPixelData, inKey);
+}
 
-	// Divide texcoords by z, to "transform them to post perspective divide space"
-	// Then, multiply by the new z to get back the standard space value.
-	// Could also be explained as "x * 1/z is linear across the screen space interpolation)
-	glm::vec2 texCoordsPerspInterp = wA * (inPixelData.A.TexCoords / inPixelData.A.ClipSpacePos.w) + wB * (inPixelData.B.TexCoords / inPixelData.B.ClipSpacePos.w) + wC * (inPixelData.C.TexCoords / inPixelData.C.ClipSpacePos.w);
-	texCoordsPerspInterp *= pixelCameraSpaceDepth;
+template<typename State>
+void SoftwareRasterizer::ShadeCoveredPixel(const int32_t inX, const int32_t inY, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey)
+{
+	using DepthTraits = DepthFormatTraits<State::DepthFormat>;
+	typename DepthTraits::StorageType* depthData = reinterpret_cast<typename DepthTraits::StorageType*>(DepthData);
+	const bool bDepthTest = State::HasFlag(inKey, Ps_DepthTest);
+	const bool bLateZ = State::HasFlag(inKey, Ps_LateZ);
+	const bool bColorWrite = State::HasFlag(inKey, Ps_ColorWrite);
 
-	texCoordsPerspInterp.y = 1.f - texCoordsPerspInterp.y;
+	const int32_t pixelPos = GetPixelPos(inX, inY);
 
-	// To get any other coordinate of the current pixel, we can just linearly interpolate it in NDC space and multiply by current pixel Camera Space depth
-	// to get camera space values.
-	// Eg.
-	//const float NDCcurrentPixelX = (wA * A_NDC.z) + (wB * B_NDC.z) + (wC * C_NDC.z);
-	//const float cameraSpacePixelX = NDCcurrentPixelX * pixelCameraSpaceDepth;
+	// x, y, z can be linearly interpolated in screen space using screen space derived barycentrics.
+	// However, nothing that's in camera space can be derived using just the screen space derived barycentrics
+	// For that we need the camera space z, see ShadeFragment
 
-	// Z can also be derived and used to test that the operations are correct
-	//// Test that demonstrates liniarity in lerping across NDC values
-	//// Lerp to get NDC z of current pixel, then transform to Camera Space using derived pixel depth
-	//const float m22 = CAMERA_FAR / (CAMERA_FAR - CAMERA_NEAR); // Persp matrix m22
-	//const float m23 = -1.f * ((CAMERA_FAR * CAMERA_NEAR) / (CAMERA_FAR - CAMERA_NEAR)); // Persp matrix m23
-	//const float ndcDepth = wA * A_NDC.z + wB * B_NDC.z + wC * C_NDC.z;
-	//const float CameraDepthAfterPerspOps = ndcDepth * pixelCameraSpaceDepth;
-	//const float CameraDepth = (CameraDepthAfterPerspOps - m23) / m22; // Under Persp matrix re-map
-	//// CameraDepth == pixelCameraSpaceDepth
+	const float ndcDepth = inPixelData.Depth.Evaluate(static_cast<float>(inX - inPixelData.PixelMinX), static_cast<float>(inY - inPixelData.PixelMinY));
 
 	if (ndcDepth <= 0.f || ndcDepth > 1.f)
 	{
 		return;
 	}
 
-	// Z Buffer
-	if (bUseZBuffer)
+	const float depthKey = DepthTraits::ToKey(ndcDepth);
+
+	// Early Z, depth is the only thing interpolated before the test so hidden pixels skip all attribute and texture work
+	// The visibility buffer only supports early Z, see SetDrawPipelineState
+	if (bDepthTest && !bLateZ)
 	{
-		const float existingDepth = DepthData[pixelPos];
-		if (ndcDepth < existingDepth)
+		if (DepthTraits::IsNearer(depthKey, DepthTraits::Load(&depthData[pixelPos])))
 		{
-			DepthData[pixelPos] = ndcDepth;
+			DepthTraits::Store(&depthData[pixelPos], depthKey);
 		}
 		else
 		{
@@ -851,84 +2663,108 @@ void SoftwareRasterizer::ShadePixel(const int32_t inX, const int32_t inY, const
 		}
 	}
 
-
-	const size_t textureHeight = inPixelData.TexHeight;
-	const size_t textureWidth = inPixelData.TexWidth;
-	const uint8_t* texels = inPixelData.TexPixels;
-
-	const size_t texelX = size_t(texCoordsPerspInterp.x * textureWidth);
-	const size_t texelY = size_t(texCoordsPerspInterp.y * textureHeight);
-
-	const size_t texelPos = texelY * (textureWidth * 4) + (texelX * 4);
-	if (texelPos >= (textureHeight * (textureWidth * 4)))
+	// First pass of the visibility buffer only stores what is visible, shading happens once per pixel in ShadeVisibilityTile
+	if (State::HasFlag(inKey, Ps_VisibilityBuffer))
 	{
-		//LOG_WARNING("Tried to sample beyond texture bounds");
+		VisibilityData[pixelPos] = inPixelData.VisibilityId;
 		return;
 	}
 
-	const glm::vec3 AColor(inPixelData.A.TexCoords.x, inPixelData.A.TexCoords.y, 0.f);
-	const glm::vec3 BColor(inPixelData.B.TexCoords.x, inPixelData.B.TexCoords.y, 0.f);
-	const glm::vec3 CColor(inPixelData.C.TexCoords.x, inPixelData.C.TexCoords.y, 0.f);
-
-
-	uint32_t RGBA = 0;
-	if (inPixelData.bHasTexture)
+	// Without color writes, shading is only needed by late Z to know which pixels are discarded
+	if (!bColorWrite && !bLateZ)
 	{
-		uint8_t* bytes = (uint8_t*)&RGBA;
-		bytes[0] = texels[texelPos];
-		bytes[1] = texels[texelPos + 1];
-		bytes[2] = texels[texelPos + 2];
-		bytes[3] = texels[texelPos + 3];
-
-		const glm::vec3 UVColor = glm::vec3(texCoordsPerspInterp.x, texCoordsPerspInterp.y, 0.f);
+		return;
 	}
-	else
+
+	uint32_t RGBA = 0;
+	if (!ShadeFragment<State>(inX, inY, inPixelData, inKey, RGBA))
 	{
-		RGBA = ConvertToRGBA(glm::vec4(1.f, 0.f, 1.f, 1.f));
+		return;
 	}
 
-	if (bDrawOnlyBackfaceCulled)
+	// Late Z, only pixels that were not discarded are tested and write depth
+	if (bDepthTest && bLateZ)
 	{
-		if (inPixelData.bCulled)
+		if (DepthTraits::IsNearer(depthKey, DepthTraits::Load(&depthData[pixelPos])))
+		{
+			DepthTraits::Store(&depthData[pixelPos], depthKey);
+		}
+		else
 		{
-			FinalImageData[pixelPos] = ConvertToRGBA(glm::vec4(1.f, 0.f, 0.f, 1.f));
+			return;
 		}
 	}
-	else
+
+	if (!bColorWrite)
 	{
-		//FinalImageData[pixelPos] = ConvertToRGBA(glm::vec4(UVColor.x, UVColor.y, UVColor.z, 1.f));
-		FinalImageData[pixelPos] = RGBA;
+		return;
 	}
 
+	using ColorTraits = ColorFormatTraits<State::ColorFormat>;
+	ColorTraits::Store(&reinterpret_cast<typename ColorTraits::StorageType*>(ColorTarget)[pixelPos], RGBA);
 }
 
-void SoftwareRasterizer::DrawPoint(const glm::vec2i& inPoint, const glm::vec4& inColor)
+template<typename State>
+bool SoftwareRasterizer::ShadeFragment(const int32_t inX, const int32_t inY, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey, uint32_t& outRGBA) const
 {
-	int32_t pixelPos = 0;
-	if (TryGetPixelPos(inPoint.x, inPoint.y, pixelPos))
+	// Untextured states interpolate nothing
+	if (!State::HasFlag(inKey, Ps_Textured))
 	{
-		FinalImageData[pixelPos] = ConvertToRGBA(inColor);
+		outRGBA = inKey.FlatColor;
+		return true;
 	}
-}
 
-void SoftwareRasterizer::DoTest()
-{
-	{
-		const glm::vec2 A(40, 58);
-		const glm::vec2 B(10, 10);
-		const glm::vec2 C(70, 30);
+	const float planeX = static_cast<float>(inX - inPixelData.PixelMinX);
+	const float planeY = static_cast<float>(inY - inPixelData.PixelMinY);
+	const TexCoordPlanes texCoordPlanes = GetTexCoordPlanes<State>(VaryingPlanes, inPixelData, inKey);
+
+	const float pixelCameraSpaceDepth = 1.f / texCoordPlanes.OneOverW->Evaluate(planeX, planeY); // Depth in camera space, 
+	// we need this because this for everything else because this is what gets used to do the perspective divide
 
-		//DrawPoint(B);
+	// Texcoords were divided by w in setup, to "transform them to post perspective divide space"
+	// Then, multiply by the new z to get back the standard space value.
+	// Could also be explained as "x * 1/z is linear across the screen space interpolation)
+	glm::vec2 texCoordsPerspInterp = glm::vec2(texCoordPlanes.UOverW->Evaluate(planeX, planeY), texCoordPlanes.VOverW->Evaluate(planeX, planeY));
+	texCoordsPerspInterp *= pixelCameraSpaceDepth;
 
-		//DrawTriangle(VtxShaderOutput{ A, 0.f, glm::vec3(0.f, 0.f, 0.f), glm::vec2(0.f, 0.f) }, VtxShaderOutput{ B, 0.f, glm::vec3(0.f, 0.f, 0.f), glm::vec2(0.f, 0.f) }, VtxShaderOutput{ C, 0.f, glm::vec3(0.f, 0.f, 0.f), glm::vec2(0.f, 0.f) });
+	texCoordsPerspInterp.y = 1.f - texCoordsPerspInterp.y;
 
-		//DrawLine(A, B, glm::vec4(0.f, 1.f, 0.f, 1.f));
-		//DrawLine(B, C, glm::vec4(0.f, 1.f, 0.f, 1.f));
-		//DrawLine(C, A, glm::vec4(0.f, 1.f, 0.f, 1.f));
+	// To get any other coordinate of the current pixel, we can just linearly interpolate it in NDC space and multiply by current pixel Camera Space depth
+	// to get camera space values.
+	// Eg.
+	//const float NDCcurrentPixelX = (wA * A_NDC.z) + (wB * B_NDC.z) + (wC * C_NDC.z);
+	//const float cameraSpacePixelX = NDCcurrentPixelX * pixelCameraSpaceDepth;
 
+	// Z can also be derived and used to test that the operations are correct
+	//// Test that demonstrates liniarity in lerping across NDC values
+	//// Lerp to get NDC z of current pixel, then transform to Camera Space using derived pixel depth
+	//const float m22 = CAMERA_FAR / (CAMERA_FAR - CAMERA_NEAR); // Persp matrix m22
+	//const float m23 = -1.f * ((CAMERA_FAR * CAMERA_NEAR) / (CAMERA_FAR - CAMERA_NEAR)); // Persp matrix m23
+	//const float ndcDepth = wA * A_NDC.z + wB * B_NDC.z + wC * C_NDC.z;
+	//const float CameraDepthAfterPerspOps = ndcDepth * pixelCameraSpaceDepth;
+	//const float CameraDepth = (CameraDepthAfterPerspOps - m23) / m22; // Under Persp matrix re-map
+	//// CameraDepth == pixelCameraSpaceDepth
 
-		//DrawLine(glm::vec2i(10, -5), glm::vec2i(10, 10), glm::vec4(0.f, 1.f, 0.f, 1.f));
-		//DrawLine(glm::vec2i(10, -20), glm::vec2i(10, 50), glm::vec4(0.f, 1.f, 0.f, 1.f));
+	uint32_t RGBA = 0;
+	if (!SampleTexture(inPixelData, texCoordPlanes, texCoordsPerspInterp, State::GetTextureFilter(inKey), inX, inY, RGBA))
+	{
+		// Discard
+		//LOG_WARNING("Tried to sample beyond texture bounds");
+		return false;
 	}
 
+	//outRGBA = ConvertToRGBA(glm::vec4(UVColor.x, UVColor.y, UVColor.z, 1.f));
+	outRGBA = RGBA;
+
+	return true;
+}
+
+void SoftwareRasterizer::DrawPoint(const glm::vec2i& inPoint, const glm::vec4& inColor)
+{
+	int32_t pixelPos = 0;
+	if (TryGetPixelPos(inPoint.x, inPoint.y, pixelPos))
+	{
+		InitializeClearedTileAt(inPoint.x, inPoint.y);
+		WriteColor(pixelPos, ConvertToRGBA(inColor));
+	}
 }
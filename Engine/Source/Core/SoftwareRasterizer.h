@@ -4,44 +4,332 @@
 #include "glm/ext/vector_float2.hpp"
 #include "EASTL/shared_ptr.h"
 #include "DirectXTex.h"
+#include "Renderer/SwizzledTexture.h"
 #include "EASTL/vector.h"
 #include "Entity/TransformObject.h"
 #include "Renderer/Model/3D/Model3D.h"
+#include "Math/SIMD.h"
+#include "Core/SoftwareOcclusionCuller.h"
+#include "Core/SoftwareRenderTarget.h"
+#include "Utils/SPSCRing.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Slots of the attributes the vertex stage outputs besides the position, all plain floats
+// They are interpolated as generic varyings, only the ones a draw's pipeline state uses are set up, see GetVaryingMask
+enum EVaryingSlot : uint8_t
+{
+	Varying_TexCoordU,
+	Varying_TexCoordV,
+	Varying_NormalX,
+	Varying_NormalY,
+	Varying_NormalZ,
+	Varying_Count
+};
 
 struct VtxShaderOutput
 {
 	glm::vec4 ClipSpacePos;
-	glm::vec3 Normal;
-	glm::vec2 TexCoords;
+	float Varyings[Varying_Count];
 };
 
-struct PixelShadeDataPkg
+// Triangles whose winding, as seen on screen, matches are culled
+enum class ETriangleCullMode : uint8_t
+{
+	None,
+	CW,
+	CCW
+};
+
+// Where the depth test happens relative to pixel shading
+// Early Z tests and writes depth before any attribute is interpolated, late Z is needed when shading can discard or change depth
+enum class EDepthTestMode : uint8_t
+{
+	EarlyZ,
+	LateZ
+};
+
+// Storage of the depth buffer
+// Unorm formats quantize NDC depth in [0, 1], Unorm24 is packed in the low bits of 32 bit words with the top 8 bits unused
+// Reversed Z projects the near plane to 1 and the far plane to 0 so float precision is spent where perspective loses it
+enum class EDepthFormat : uint8_t
+{
+	Float32,
+	Unorm16,
+	Unorm24,
+	Float32ReversedZ,
+	Count
+};
+
+// Storage of the color target
+// Shading outputs RGBA8 colors, formats other than RGBA8 pack them on store and are converted back to RGBA8 when resolving
+// Float formats can keep values above 1 for HDR work, RGBA16F at 8 bytes per pixel, R11G11B10F at 4 but with no alpha, which resolves to opaque
+enum class EColorFormat : uint8_t
+{
+	RGBA8,
+	RGBA16F,
+	R11G11B10F,
+	RGB10A2,
+	Count
+};
+
+// How textures are sampled
+// Mips are selected from the texcoord derivatives across each 2x2 pixel quad
+enum class ETextureFilter : uint8_t
+{
+	BaseLevelPoint,
+	NearestMipPoint,
+	Trilinear,
+	Count
+};
+
+// What the triangles of a draw do once they are rasterized, see PipelineStateKey
+enum EPipelineStateFlags : uint8_t
+{
+	Ps_DepthTest = 1 << 0,			// Depth is tested and written
+	Ps_LateZ = 1 << 1,				// After shading instead of before, see EDepthTestMode
+	Ps_VisibilityBuffer = 1 << 2,	// Rasterization only stores the triangle, shading happens once per pixel when the tile is done
+	Ps_Textured = 1 << 3,			// Color is sampled from the draw's texture, FlatColor otherwise
+	Ps_ColorWrite = 1 << 4
+};
+
+// Everything that decides which code the pixels of a draw run
+// Each draw looks its key up once and its triangles then go straight to the raster and shade kernels compiled for it, see SoftwareRasterizer::GetPipelineStateIdx
+// Cull mode is not part of it, culled triangles never reach the rasterizer, and there is no blending
+struct PipelineStateKey
+{
+	EDepthFormat DepthFormat = EDepthFormat::Float32;
+	EColorFormat ColorFormat = EColorFormat::RGBA8;
+	// Only meaningful with Ps_Textured
+	ETextureFilter TextureFilter = ETextureFilter::BaseLevelPoint;
+	// EPipelineStateFlags
+	uint8_t Flags = 0;
+	// Varyings interpolated for the pixels, bit per EVaryingSlot
+	uint16_t VaryingMask = 0;
+	// Color of untextured pixels, a constant of the draw rather than compiled in
+	uint32_t FlatColor = 0;
+
+	inline bool operator==(const PipelineStateKey& inOther) const
+	{
+		return DepthFormat == inOther.DepthFormat && ColorFormat == inOther.ColorFormat && TextureFilter == inOther.TextureFilter && Flags == inOther.Flags && VaryingMask == inOther.VaryingMask && FlatColor == inOther.FlatColor;
+	}
+};
+
+// Varyings the shading of a pipeline state reads
+constexpr uint16_t GetVaryingMask(const uint8_t inFlags)
+{
+	return (inFlags & Ps_Textured) ? (1u << Varying_TexCoordU) | (1u << Varying_TexCoordV) : 0u;
+}
+
+// Varying planes of a triangle are stored in slot order after its 1 / w plane, see PixelShadeDataPkg::FirstVaryingPlane
+constexpr int32_t GetVaryingPlaneIdx(const uint16_t inVaryingMask, const int32_t inSlot)
+{
+	int32_t planeIdx = 1;
+	for (int32_t slot = 0; slot < inSlot; ++slot)
+	{
+		planeIdx += (inVaryingMask >> slot) & 1;
+	}
+
+	return planeIdx;
+}
+
+// Per frame counters of the triangles rejected by each stage before rasterization
+struct SoftwareRasterizerStats
+{
+	int32_t MeshNodesCulled = 0;
+	int32_t OcclusionNodesTested = 0;
+	int32_t OcclusionNodesCulled = 0;
+	float OcclusionCullingMs = 0.f;
+	int32_t TrianglesSubmitted = 0;
+	int32_t FrustumCulled = 0;
+	int32_t BackfaceCulled = 0;
+	int32_t DegenerateCulled = 0;
+	int32_t NoSamplesCulled = 0;
+	int32_t TrianglesBinned = 0;
+	int32_t HiZCulledTriangles = 0;
+	int32_t HiZCulledBlocks = 0;
+	int32_t TilesLeftCleared = 0;
+	float TileRasterMs = 0.f;
+	int32_t NumRasterThreads = 0;
+	// Pipeline states drawn with, and how many of them have no kernels of their own and read their flags per pixel
+	int32_t PipelineStates = 0;
+	int32_t GenericPipelineStates = 0;
+};
+
+// Debug settings a frame is rendered with
+// They are read from the debug UI on the main thread and handed over with the frame, so they can not change while it renders
+struct SoftwareRasterizerSettings
+{
+	EDepthFormat DepthFormat = EDepthFormat::Float32;
+	EColorFormat ColorFormat = EColorFormat::RGBA8;
+	ETextureFilter TextureFilter = ETextureFilter::Trilinear;
+	bool bDepthTest = true;
+	bool bVisibilityBuffer = false;
+	bool bKeepTileAffinity = true;
+	bool bShowCulledTriangles = false;
+	bool bDrawWireframe = false;
+	bool bUseReferenceRasterizer = false;
+	bool bUseSIMDRasterizer = true;
+	bool bUseOcclusionCulling = false;
+	int32_t NumOccluders = 8;
+};
+
+// A MeshNode as drawn in a frame, copied from the scene graph by the thread that owns it
+// The scene graph keeps changing on the main thread and even reading an absolute transform can write its cache, so the render thread only sees these
+struct MeshNodeSnapshot
+{
+	// Keeps the node alive, only its vertices, indices and bounds are read and they do not change once loaded
+	eastl::shared_ptr<MeshNode> Node;
+	glm::mat4 AbsoluteTransform = glm::mat4(1.f);
+	// Null if the node is untextured
+	eastl::shared_ptr<D3D12Texture2D> AlbedoMap;
+};
+
+struct SceneSnapshot
+{
+	glm::mat4 View = glm::mat4(1.f);
+	// In drawing order, children before their parent
+	eastl::vector<MeshNodeSnapshot> MeshNodes;
+};
+
+// A node that passed frustum culling, either rasterized as an occluder or tested against them
+struct OcclusionCandidate
+{
+	const MeshNode* Node = nullptr;
+	glm::mat4 ObjectToClip = glm::mat4(1.f);
+	// Nearest view depth of the bounding box
+	float Distance = 0.f;
+};
+
+// Output of the vertex stage for a whole MeshNode, as structure of arrays
+// Triangles index into it with the node's indices so shared vertices are only transformed once
+struct PostTransformVertexBuffer
+{
+	eastl::vector<float> ClipX;
+	eastl::vector<float> ClipY;
+	eastl::vector<float> ClipZ;
+	eastl::vector<float> ClipW;
+
+	// Only grows, so a buffer reused across nodes and frames stops allocating once it fits the largest node
+	inline void Resize(const int32_t inNumVertices)
+	{
+		ClipX.resize(inNumVertices);
+		ClipY.resize(inNumVertices);
+		ClipZ.resize(inNumVertices);
+		ClipW.resize(inNumVertices);
+	}
+
+	inline glm::vec4 GetClipSpacePos(const uint32_t inIdx) const
+	{
+		return glm::vec4(ClipX[inIdx], ClipY[inIdx], ClipZ[inIdx], ClipW[inIdx]);
+	}
+};
+
+// Vertices are snapped to a fixed point grid with SUBPIXEL_BITS of fractional precision (28.4 by default)
+constexpr int32_t SUBPIXEL_BITS = 4;
+constexpr int32_t SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+constexpr int32_t SUBPIXEL_HALF = SUBPIXEL_SCALE / 2;
+
+// Snapped coordinates have to stay within +-MAX_SUBPIXEL_COORD so that edge values stay within 32 bits inside a raster block
+constexpr int32_t MAX_SUBPIXEL_COORD = 1 << 18;
+static_assert(SUBPIXEL_BITS <= 6, "Edge values inside a raster block would overflow 32 bits");
+
+// E(x, y) = StepX * x + StepY * y + Origin, with x and y in sub-pixels
+// Positive inside the triangle, the top-left fill rule bias is part of Origin so the coverage test is always E >= 0
+struct EdgeFunction
 {
-	glm::vec3 A_NDC;
-	glm::vec3 B_NDC;
-	glm::vec3 C_NDC;
+	int32_t StepX = 0;
+	int32_t StepY = 0;
+	int64_t Origin = 0;
 
-	glm::vec3 vtxAScreenSpace;
-	glm::vec3 vtxBScreenSpace;
-	glm::vec3 vtxCScreenSpace;
+	inline int64_t Evaluate(const int64_t inX, const int64_t inY) const
+	{
+		return StepX * inX + StepY * inY + Origin;
+	}
 
+	inline int64_t EvaluatePixelCenter(const int32_t inPixelX, const int32_t inPixelY) const
+	{
+		return Evaluate(int64_t(inPixelX) * SUBPIXEL_SCALE + SUBPIXEL_HALF, int64_t(inPixelY) * SUBPIXEL_SCALE + SUBPIXEL_HALF);
+	}
+};
+
+// f(x, y) = DDX * x + DDY * y + Origin, with x and y in pixels relative to the triangle's PixelMinX and PixelMinY
+struct ScreenPlane
+{
+	float DDX = 0.f;
+	float DDY = 0.f;
+	float Origin = 0.f;
+
+	inline float Evaluate(const float inX, const float inY) const
+	{
+		return DDX * inX + DDY * inY + Origin;
+	}
+};
+
+// Everything rasterization and shading need of a triangle, stored once per triangle and binned by index
+// Varyings are screen space planes of their value over w, with the plane of 1 / w they cost a multiply-add per plane and a single reciprocal per pixel
+struct PixelShadeDataPkg
+{
+	// Pixel space vertices before snapping, the reference rasterizer and the wireframe debug view work on them
 	glm::vec2 A_PS;
 	glm::vec2 B_PS;
 	glm::vec2 C_PS;
 
-	VtxShaderOutput A;
-	VtxShaderOutput B;
-	VtxShaderOutput C;
+	// All mips, swizzled, null when untextured
+	const SwizzledTexture* Texture = nullptr;
+
+	// NDC depth is linear in screen space
+	ScreenPlane Depth;
 
-	uint8_t* TexPixels;
-	size_t TexWidth;
-	size_t TexHeight;
-	bool bHasTexture = false;
+	// Index of the triangle's first plane in the frame's varying planes, the 1 / w plane followed by the pipeline state's varyings, see GetVaryingPlaneIdx
+	uint32_t FirstVaryingPlane = 0;
 
-	bool bCulled = false;
+	// Index in the frame's pipeline states, see SoftwareRasterizer::FramePipelineStates
+	uint16_t PipelineStateIdx = 0;
+
+	// Index in the frame's triangle setups + 1, what the visibility buffer stores for the pixels this triangle covers
+	// Setups already carry the draw's state, so this single id stands for both the draw and the triangle
+	uint32_t VisibilityId = 0;
+
+	// Nearest NDC depth of the triangle, tested against Hi-Z
+	// The smallest depth of its vertices, or the largest with reversed Z
+	float NearestDepth = 0.f;
+
+	// Edge opposite to each vertex, positive inside
+	EdgeFunction EdgeA;
+	EdgeFunction EdgeB;
+	EdgeFunction EdgeC;
+
+	// Screen clamped bounding box in pixels, inclusive, planes are relative to its min corner
+	int32_t PixelMinX = 0;
+	int32_t PixelMinY = 0;
+	int32_t PixelMaxX = 0;
+	int32_t PixelMaxY = 0;
+};
+
+void RenderThreadRun(class SoftwareRasterizer* inRasterizer);
+
+// Color targets cycled between the render thread, which draws into one, and the main thread, which presents the last completed one
+constexpr int32_t NUM_COLOR_BUFFERS = 2;
+
+// Async rendering
+// A request carries everything the frame is drawn from, the render thread never reads the scene graph or the debug UI
+struct FrameRequest
+{
+	SceneSnapshot Scene;
+	SoftwareRasterizerSettings Settings;
+	ETriangleCullMode CullMode = ETriangleCullMode::CCW;
+	EDepthTestMode DepthTestMode = EDepthTestMode::EarlyZ;
+	bool bRunScalingBenchmark = false;
 };
 
-void ShadingThreadRun(class SoftwareRasterizer* inRasterizer);
+struct CompletedFrame
+{
+	int32_t ColorBufferIdx = -1;
+	SoftwareRasterizerStats Stats;
+};
 
 class SoftwareRasterizer
 {
@@ -49,35 +337,252 @@ public:
 	SoftwareRasterizer() = default;
 	void Init(const int32_t inImageWidth, const int32_t inImageHeight);
 	~SoftwareRasterizer();
-	void TransposeImage();
-	void DrawModel(const eastl::shared_ptr<class Model3D>& inModel);
-	void DrawModelWireframe(const eastl::shared_ptr<class Model3D>& inModel);
+	void DrawModel(const eastl::shared_ptr<class Model3D>& inModel, const ETriangleCullMode inCullMode = ETriangleCullMode::CCW, const EDepthTestMode inDepthTestMode = EDepthTestMode::EarlyZ);
 	void DrawLine(const glm::vec2i& inStart, const glm::vec2i& inEnd, const glm::vec4& inColor = glm::vec4(1.f, 1.f, 1.f, 1.f));
 	void DrawRandom();
-	void bresenhamFull(int x1, int y1, int x2, int y2);
+	// Image resolved by PrepareBeforePresent, synchronous rendering only
 	uint32_t* GetImage();
 	void PrepareBeforePresent();
 	void BeginFrame();
-	void ClearImageBuffers();
-	inline bool TryGetPixelPos(const int32_t X, const int32_t Y, int32_t& outPixelPos);
-	void DrawChildren(const eastl::vector<TransformObjPtr>& inChildren, const glm::mat4& inProj, const glm::mat4& inView, const eastl::vector<MeshMaterial>& inMaterials);
 
+	// Async rendering, frames are rendered on a dedicated thread while the main thread keeps presenting the last completed one
+	// Once started, only SubmitFrame, AcquireCompletedFrame and ResolvePresentedImage should be used to render
+	void StartRenderThread();
+	// Has to be called while the job system is still running
+	void StopRenderThread();
+	// Main thread, queues a frame of the model seen from the current camera, replacing the queued frame the render thread has not started yet
+	void SubmitFrame(const eastl::shared_ptr<class Model3D>& inModel, const ETriangleCullMode inCullMode = ETriangleCullMode::CCW, const EDepthTestMode inDepthTestMode = EDepthTestMode::EarlyZ);
+	// Main thread, presents the newest completed frame, false until the first one completes
+	// The presented frame stays unchanged until the next call
+	bool AcquireCompletedFrame();
+	// Main thread, resolves the presented frame into an image with rows inRowPitch bytes apart, see ResolveImage
+	void ResolvePresentedImage(uint8_t* outImage, const uint64_t inRowPitch) const;
+	// Main thread, the render thread runs RunScalingBenchmark before drawing the next submitted frame
+	inline void RequestScalingBenchmark() { bScalingBenchmarkRequested = true; }
 
+	// Fast clear, only flags the tiles, see InitializeClearedTile and ResolveClearedTiles
+	void ClearImageBuffers();
+	inline EDepthFormat GetDepthFormat() const { return DepthFormat; }
+	inline EColorFormat GetColorFormat() const { return ColorTargetFormat; }
+	// Position of the pixel in the render targets, see GetPixelPos
+	inline bool TryGetPixelPos(const int32_t X, const int32_t Y, int32_t& outPixelPos);
 
-	void DrawTriangle(const VtxShaderOutput& A, const VtxShaderOutput& B, const VtxShaderOutput& C, const DirectX::Image* CPUImage);
+	// Picks its own pipeline state, draws of many triangles should use SetDrawPipelineState and ClipTriangle instead
+	void DrawTriangle(const VtxShaderOutput& A, const VtxShaderOutput& B, const VtxShaderOutput& C, const SwizzledTexture* inTexture);
 	void DrawPoint(const glm::vec2i& inPoint, const glm::vec4& inColor = glm::vec4(1.f, 1.f, 1.f, 1.f));
-	void DoTest();
+	// Stats of the last completed frame
+	inline const SoftwareRasterizerStats& GetStats() const { return PresentedStats; }
 
 private:
+	using RasterKernel = bool (SoftwareRasterizer::*)(const PixelShadeDataPkg&, const PipelineStateKey&, const int32_t, const int32_t, const int32_t, const int32_t, int32_t&);
+	using ShadeKernel = bool (SoftwareRasterizer::*)(const int32_t, const int32_t, const PixelShadeDataPkg&, const PipelineStateKey&, uint32_t&) const;
+
+	// A pipeline state used during the frame and the kernels picked for it
+	struct FramePipelineState
+	{
+		PipelineStateKey Key;
+		RasterKernel Rasterize = nullptr;
+		// Visibility buffer shading, null when the state writes no color
+		ShadeKernel Shade = nullptr;
+		// No kernels of its own, see TGenericPipelineState
+		bool bGeneric = false;
+	};
+
+	// ImGui window, main thread only
+	void DrawDebugUI();
+	// Frame work shared by the synchronous and the async path
+	void StartFrame(const SoftwareRasterizerSettings& inSettings);
+	// Allocates the render targets the frame's pipeline writes and releases the others
+	void AllocateRenderTargets();
+	void DrawScene(const SceneSnapshot& inScene, const ETriangleCullMode inCullMode, const EDepthTestMode inDepthTestMode);
+	void DrawMeshNodes(const eastl::vector<MeshNodeSnapshot>& inNodes, const glm::mat4& inProj, const glm::mat4& inView);
+	void FinishFrame();
+	void RunRenderThread();
+	// Renders the frame again and again with 1, 2, 4... threads up to all job system workers, with and without tile affinity, and logs the average times
+	void RunScalingBenchmark(const SceneSnapshot& inScene, const SoftwareRasterizerSettings& inSettings, const ETriangleCullMode inCullMode, const EDepthTestMode inDepthTestMode);
+
+	// Rasterizes the nearest nodes into the occlusion buffer and fills OccludedNodes with the ones they hide
+	void CullOccludedNodes(const eastl::vector<MeshNodeSnapshot>& inNodes, const glm::mat4& inProj, const glm::mat4& inView);
+
+	// Pipeline state of the triangles drawn next, from the frame's state and the draw's texture
+	void SetDrawPipelineState(const SwizzledTexture* inTexture);
+	// Index of the key in the frame's pipeline states, added with its kernels the first time it is used
+	uint16_t GetPipelineStateIdx(const PipelineStateKey& inKey);
+	// Kernels of the key, from the compiled permutations when it is one of them, see CompiledPipelineStates
+	void GetPipelineKernels(const PipelineStateKey& inKey, FramePipelineState& outState);
+
+	// Primitive assembly, clips the triangle and sets up what is left of it with the current pipeline state
+	void ClipTriangle(const VtxShaderOutput& A, const VtxShaderOutput& B, const VtxShaderOutput& C, const SwizzledTexture* inTexture);
+	// Triangle setup and binning for a triangle that is already clipped
+	void SetupTriangle(const VtxShaderOutput& A, const VtxShaderOutput& B, const VtxShaderOutput& C, const SwizzledTexture* inTexture);
+
+	// Vertex stage, transforms all vertices of a node to clip space into the post-transform buffer
+	void TransformVertices(const eastl::vector<SimpleVertex>& inVertices, const glm::mat4& inWorldToClip);
+
+	// Rasterizes all triangles binned during the frame, one parallel for over all tiles
+	void RasterizeBinnedTriangles();
+	void RasterizeTiles(const int32_t inBeginTileIdx, const int32_t inEndTileIdx);
+	void RasterizeTile(const int32_t inTileIdx);
+	// Everything reading or writing depth is compiled once per depth format, everything writing color once per color format
+	template<EDepthFormat Format, EColorFormat ColorFormat>
+	void RasterizeTile(const int32_t inTileIdx);
+	// Raster kernel of a pipeline state, rasterizes and shades the part of the triangle inside the pixel rect
+	// State is a TPipelineState, whose flags are constants so the kernel has no branch on them and only interpolates what it uses, or a TGenericPipelineState
+	// Returns true if depth might have been written, Hi-Z of the touched blocks is then already updated
+	template<typename State>
+	bool RasterizeTriangle(const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey, const int32_t inMinX, const int32_t inMinY, const int32_t inMaxX, const int32_t inMaxY, int32_t& ioHiZCulledBlocks);
+	// Reference path, tests coverage for the pixel using Cramer's rule
+	template<typename State>
+	void ShadePixel(const int32_t inX, const int32_t inY, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey);
+	template<typename State>
+	void ShadeCoveredPixel(const int32_t inX, const int32_t inY, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey);
+	// Shade kernel of a pipeline state, interpolates varyings and samples textures, returns false if the fragment is discarded
+	template<typename State>
+	bool ShadeFragment(const int32_t inX, const int32_t inY, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey, uint32_t& outRGBA) const;
+	// Visibility buffer resolve, shades every pixel of the rect once from the triangle id it stores
+	template<EColorFormat ColorFormat>
+	void ShadeVisibilityTile(const int32_t inMinX, const int32_t inMinY, const int32_t inMaxX, const int32_t inMaxY);
+
+	// Walks the triangle in 8x8 blocks, skipping blocks fully outside and filling blocks fully inside without coverage tests
+	// Rows of a block are tested, depth tested and shaded SIMD::Width pixels at once
+	// Returns true if depth might have been written, Hi-Z of the touched blocks is then already updated
+	template<typename State>
+	bool RasterizeTriangleSIMD(const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey, const int32_t inMinX, const int32_t inMinY, const int32_t inMaxX, const int32_t inMaxY, int32_t& ioHiZCulledBlocks);
+	// Shades the block row starting at inX, inY
+	template<typename State>
+	bool ShadeBlockSIMD(const int32_t inX, const int32_t inY, const uint32_t inCoverageBits, const struct SIMDTriangleInterpolants& inInterpolants, const PixelShadeDataPkg& inPixelData, const PipelineStateKey& inKey);
+
+	// Clears the buffers of a tile flagged as cleared, before its first write
+	void InitializeClearedTile(const int32_t inTileIdx);
+	void InitializeClearedTileAt(const int32_t inX, const int32_t inY);
+	template<EDepthFormat Format, EColorFormat ColorFormat>
+	void ClearTile(const int32_t inTileIdx);
+	// Fills the color of the tiles nothing was written to during the frame
+	template<EColorFormat ColorFormat>
+	void ResolveClearedTiles();
+	// Debug drawing, a single pixel of the current color target
+	void WriteColor(const int32_t inPixelPos, const uint32_t inRGBA);
 
-	void ShadePixel(const int32_t inX, const int32_t inY, const PixelShadeDataPkg& inPixelData);
+	// Converts a color target to an RGBA8 image, linear with y going down as D3D expects, one parallel for over bands of block rows
+	// Format conversion, the optional sRGB encode and dithering are all done in this single pass, so it can write straight to upload memory
+	void ResolveImage(const int32_t inColorBufferIdx, uint8_t* outImage, const uint64_t inRowPitch) const;
+	template<EColorFormat ColorFormat>
+	void ResolveBlockRows(const uint8_t* inColorTarget, uint8_t* outImage, const uint64_t inRowPitch, const int32_t inBeginBlockY, const int32_t inEndBlockY, const bool inEncodeSRGB, const bool inDither) const;
 
-	friend void ShadingThreadRun(class SoftwareRasterizer* inRasterizer);
+	// Render targets are stored in RASTER_BLOCK_SIZE x RASTER_BLOCK_SIZE blocks, each one contiguous with its pixels row by row
+	// Blocks follow each other a row of blocks at a time, so a block row is one SIMD batch and a whole block spans a few cache lines
+	inline int32_t GetPixelPos(const int32_t inX, const int32_t inY) const;
+
+	// Recomputes the farthest depth of a Hi-Z block from the depth buffer
+	template<EDepthFormat Format>
+	void UpdateHiZBlock(const int32_t inBlockX, const int32_t inBlockY);
+	// Farthest depth over all Hi-Z blocks touching the pixel rect
+	template<EDepthFormat Format>
+	float GetHiZFarthestDepth(const int32_t inMinX, const int32_t inMinY, const int32_t inMaxX, const int32_t inMaxY) const;
+
+	friend void RenderThreadRun(class SoftwareRasterizer* inRasterizer);
 
 private:
+	// Render targets only exist while the pipeline uses them, see AllocateRenderTargets
+	SoftwareRenderTarget ColorTargets[NUM_COLOR_BUFFERS];
+	// Format each color target was last drawn in, what it is resolved from
+	EColorFormat ColorTargetFormats[NUM_COLOR_BUFFERS] = {};
+	int32_t CurrentColorBuffer = 0;
+	// Data of the color target the current frame is drawn into, in blocks, see GetPixelPos
+	uint8_t* ColorTarget = nullptr;
+	EColorFormat ColorTargetFormat = EColorFormat::RGBA8;
+	// Resolved image of synchronous rendering
 	uint32_t* FinalImageData = nullptr;
-	float* DepthData = nullptr;
-	glm::vec4* IntermediaryImageData = nullptr;
+	// Index of the color target the main thread is presenting in async mode, -1 before the first completed frame
+	int32_t PresentedColorBuffer = -1;
+	SoftwareRenderTarget DepthTarget;
+	// Data of DepthTarget, read through the storage type of DepthFormat, in blocks like ColorTarget, null without depth test
+	uint8_t* DepthData = nullptr;
+	EDepthFormat DepthFormat = EDepthFormat::Float32;
+	// Depth test and visibility buffer of the frame, they decide which targets exist
+	bool bDepthTestEnabled = true;
+	bool bVisibilityBufferEnabled = false;
+	ETextureFilter TextureFilter = ETextureFilter::Trilinear;
+	// Debug view, only backface culled triangles are drawn, in red
+	bool bShowCulledTriangles = false;
+	// Tiles are split between the workers the same way every frame, see JobSystem::ParallelForWithAffinity
+	bool bKeepTileAffinity = true;
+	// Debug drawing and raster paths of the frame, see SoftwareRasterizerSettings
+	bool bDrawWireframe = false;
+	bool bReferenceRasterizer = false;
+	bool bSIMDRasterizer = true;
+	bool bOcclusionCulling = false;
+	int32_t NumOccluders = 0;
+	// Visibility buffer, VisibilityId of the triangle visible in each pixel, 0 when empty, in blocks like ColorTarget
+	SoftwareRenderTarget VisibilityTarget;
+	uint32_t* VisibilityData = nullptr;
+	// Farthest depth of each HIZ_BLOCK_SIZE x HIZ_BLOCK_SIZE block of DepthData, in the format's comparison space
+	float* HiZData = nullptr;
+	int32_t HiZWidth = 0;
+	int32_t HiZHeight = 0;
 	int32_t ImageWidth = 0;
 	int32_t ImageHeight = 0;
+	// Render targets are padded to whole blocks
+	int32_t NumBlocksX = 0;
+	int32_t NumBlocksY = 0;
+
+	// Culling and depth state of the current draw
+	ETriangleCullMode CurrentCullMode = ETriangleCullMode::CCW;
+	EDepthTestMode CurrentDepthTestMode = EDepthTestMode::EarlyZ;
+	// Pipeline states of the current draw's triangles, the culled one is only used by the culled triangles debug view
+	uint16_t CurrentPipelineState = 0;
+	uint16_t CurrentCulledPipelineState = 0;
+	// Pipeline states used during the frame, setups index into it so triangles find their kernels with a single load
+	eastl::vector<FramePipelineState> FramePipelineStates;
+	SoftwareRasterizerStats Stats;
+	// Copy of Stats handed over with the last completed frame, what the main thread reads
+	SoftwareRasterizerStats PresentedStats;
+
+	SoftwareOcclusionCuller OcclusionCuller;
+	// Kept to reuse its memory between draws
+	eastl::vector<OcclusionCandidate> OcclusionCandidates;
+	// Nodes of the current draw found occluded, sorted
+	eastl::vector<const MeshNode*> OccludedNodes;
+
+	// Sort-middle binning
+	// All triangles of a frame are set up and stored once, each screen tile keeps the indices of the triangles that touch it, in submission order.
+	// Tiles are then rasterized in parallel, a tile being owned by a single thread so no synchronization is needed on the image buffers.
+	eastl::vector<PixelShadeDataPkg> TriangleSetups;
+	// Varying planes of the setups, each setup's are contiguous, see PixelShadeDataPkg::FirstVaryingPlane
+	eastl::vector<ScreenPlane> VaryingPlanes;
+	eastl::vector<eastl::vector<uint32_t>> TileBins;
+	int32_t NumTilesX = 0;
+	int32_t NumTilesY = 0;
+	int32_t NumTotalTiles = 0;
+
+	// Fast clear, clearing a frame only flags every tile as cleared
+	// A flagged tile's buffers still hold old contents, they are cleared on the first write into the tile
+	// and tiles no geometry touched only get their color filled when the frame is finished
+	eastl::vector<uint8_t> TileCleared;
+
+	// Clip space positions of the MeshNode currently being drawn, reused for every node so it only grows
+	PostTransformVertexBuffer PostTransformVertices;
+
+	// Hi-Z rejections of the frame, summed per tile by the raster threads
+	std::atomic<int32_t> HiZCulledTriangles = ATOMIC_VAR_INIT(0);
+	std::atomic<int32_t> HiZCulledBlocks = ATOMIC_VAR_INIT(0);
+
+	// Async rendering
+	// The main thread sends frame requests, the render thread sends back completed color buffers and the main thread returns the ones it is done presenting
+	// Each ring has a single producer and a single consumer so the handoff needs no lock
+	// Requests are not queued, a new one replaces the one the render thread has not taken yet so that it always renders the newest
+	std::mutex FrameRequestMutex;
+	FrameRequest PendingFrameRequest;
+	bool bFrameRequestPending = false;
+	// Render thread sleeps on it until it has a free buffer and a request, or has to stop, guarded by FrameRequestMutex
+	std::condition_variable RenderThreadWakeCondition;
+
+	TSPSCRing<CompletedFrame, NUM_COLOR_BUFFERS> CompletedFrames;
+	TSPSCRing<int32_t, NUM_COLOR_BUFFERS> FreeColorBuffers;
+
+	std::thread RenderThread;
+	std::atomic<bool> bStopRenderThread = ATOMIC_VAR_INIT(false);
+
+	// Main thread only, sent along with the next frame request
+	bool bScalingBenchmarkRequested = false;
 };
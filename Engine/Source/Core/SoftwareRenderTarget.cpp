@@ -0,0 +1,28 @@
+#include "Core/SoftwareRenderTarget.h"
+#include <malloc.h>
+
+SoftwareRenderTarget::~SoftwareRenderTarget()
+{
+	Release();
+}
+
+void SoftwareRenderTarget::Allocate(const SoftwareRenderTargetDesc& inDesc)
+{
+	if (Data != nullptr && inDesc.GetSizeBytes() == Desc.GetSizeBytes())
+	{
+		Desc = inDesc;
+		return;
+	}
+
+	Release();
+
+	Desc = inDesc;
+	Data = static_cast<uint8_t*>(_aligned_malloc(Desc.GetSizeBytes(), RENDER_TARGET_ALIGNMENT));
+}
+
+void SoftwareRenderTarget::Release()
+{
+	_aligned_free(Data);
+	Data = nullptr;
+	Desc = SoftwareRenderTargetDesc();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Render targets start on a cache line, so every 8x8 block of 1 byte pixels or more covers whole lines
+constexpr size_t RENDER_TARGET_ALIGNMENT = 64;
+
+// Size of a software render target
+// Pixels are stored in blocks, NumPixels includes the padding of the blocks past the image edges
+struct SoftwareRenderTargetDesc
+{
+	int32_t NumPixels = 0;
+	int32_t BytesPerPixel = 0;
+
+	inline size_t GetSizeBytes() const { return size_t(NumPixels) * BytesPerPixel; }
+};
+
+// Memory of a software render target, what is stored in it is up to its user
+class SoftwareRenderTarget
+{
+public:
+	SoftwareRenderTarget() = default;
+	~SoftwareRenderTarget();
+	SoftwareRenderTarget(const SoftwareRenderTarget&) = delete;
+	SoftwareRenderTarget& operator=(const SoftwareRenderTarget&) = delete;
+
+	// Keeps the current memory if the size does not change, the contents are undefined otherwise
+	void Allocate(const SoftwareRenderTargetDesc& inDesc);
+	void Release();
+
+	inline bool IsAllocated() const { return Data != nullptr; }
+	inline const SoftwareRenderTargetDesc& GetDesc() const { return Desc; }
+	inline uint8_t* GetData() const { return Data; }
+
+private:
+	SoftwareRenderTargetDesc Desc;
+	uint8_t* Data = nullptr;
+};
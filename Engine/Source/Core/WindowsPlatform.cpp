@@ -104,6 +104,51 @@ namespace WindowsPlatform
  		::Sleep(inMilliseconds);
  	}
 
+	// Threads
+
+	eastl::vector<ProcessorCoreInfo> GetPhysicalCores()
+	{
+		eastl::vector<ProcessorCoreInfo> cores;
+
+		DWORD bufferSize = 0;
+		::GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &bufferSize);
+		if (bufferSize == 0)
+		{
+			return cores;
+		}
+
+		eastl::vector<uint8_t> buffer(bufferSize);
+		if (!::GetLogicalProcessorInformationEx(RelationProcessorCore, reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data()), &bufferSize))
+		{
+			return cores;
+		}
+
+		// Entries are variable sized
+		for (DWORD offset = 0; offset < bufferSize;)
+		{
+			const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+
+			// A core always is in a single group
+			ProcessorCoreInfo core;
+			core.LogicalProcessorMask = static_cast<uint64_t>(info->Processor.GroupMask[0].Mask);
+			core.Group = info->Processor.GroupMask[0].Group;
+			cores.push_back(core);
+
+			offset += info->Size;
+		}
+
+		return cores;
+	}
+
+	void SetThreadCoreAffinity(void* inThreadHandle, const ProcessorCoreInfo& inCore)
+	{
+		GROUP_AFFINITY affinity = {};
+		affinity.Mask = static_cast<KAFFINITY>(inCore.LogicalProcessorMask);
+		affinity.Group = inCore.Group;
+
+		Win32Call(::SetThreadGroupAffinity(static_cast<HANDLE>(inThreadHandle), &affinity, nullptr));
+	}
+
 	// CLI
 
 	void SetCLITextColor(CLITextColor inColor)
@@ -4,6 +4,7 @@
 #include "InputSystem/CursorMode.h"
 #include "InputSystem/InputType.h"
 #include "EASTL/string.h"
+#include "EASTL/vector.h"
 #include "glm/glm.hpp"
 
 struct HKEY__;
@@ -20,6 +21,13 @@ namespace Windows
 	typedef HKEY__* HKEY;
 }
 
+// A physical core, as the mask of its logical processors within a processor group
+struct ProcessorCoreInfo
+{
+	uint64_t LogicalProcessorMask = 0;
+	uint16_t Group = 0;
+};
+
 eastl::wstring AnsiToWString(const char* ansiString);
 eastl::string WStringToAnsi(const wchar_t* wideString);
 
@@ -34,6 +42,10 @@ namespace WindowsPlatform
 	void InitCycles();
 	double GetTime();
 	void Sleep(uint32_t inMilliseconds);
+
+	// Empty if the topology could not be queried
+	eastl::vector<ProcessorCoreInfo> GetPhysicalCores();
+	void SetThreadCoreAffinity(void* inThreadHandle, const ProcessorCoreInfo& inCore);
 	void SetCLITextColor(CLITextColor inColor);
 	EInputKey WindowsKeyToInternal(const int16_t inWindowsKey);
 	void PoolMessages();
@@ -83,6 +83,8 @@ struct AABB
 
 	void DebugDraw() const;
 
+	inline bool IsValid() const { return IsInitialized; }
+
 private:
 	bool IsInitialized = false;
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "Math/Frustum.h"
+
+Frustum Frustum::FromMatrix(const glm::mat4& inMatrix)
+{
+	// glm matrices are column major, rows are gathered from the columns
+	const glm::vec4 row0(inMatrix[0][0], inMatrix[1][0], inMatrix[2][0], inMatrix[3][0]);
+	const glm::vec4 row1(inMatrix[0][1], inMatrix[1][1], inMatrix[2][1], inMatrix[3][1]);
+	const glm::vec4 row2(inMatrix[0][2], inMatrix[1][2], inMatrix[2][2], inMatrix[3][2]);
+	const glm::vec4 row3(inMatrix[0][3], inMatrix[1][3], inMatrix[2][3], inMatrix[3][3]);
+
+	Frustum frustum;
+	frustum.Planes[Left] = row3 + row0;
+	frustum.Planes[Right] = row3 - row0;
+	frustum.Planes[Bottom] = row3 + row1;
+	frustum.Planes[Top] = row3 - row1;
+	frustum.Planes[Near] = row2;
+	frustum.Planes[Far] = row3 - row2;
+
+	// Normalized so that plane distances are real distances, needed for spheres
+	for (glm::vec4& plane : frustum.Planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+bool Frustum::Intersects(const Sphere& inSphere) const
+{
+	for (const glm::vec4& plane : Planes)
+	{
+		if (glm::dot(glm::vec3(plane), inSphere.Center) + plane.w < -inSphere.Radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Frustum::Intersects(const AABB& inBox) const
+{
+	for (const glm::vec4& plane : Planes)
+	{
+		// Corner furthest along the plane normal, if it is outside then the whole box is
+		const glm::vec3 positiveVertex(plane.x >= 0.f ? inBox.Max.x : inBox.Min.x, plane.y >= 0.f ? inBox.Max.y : inBox.Min.y, plane.z >= 0.f ? inBox.Max.z : inBox.Min.z);
+
+		if (glm::dot(glm::vec3(plane), positiveVertex) + plane.w < 0.f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
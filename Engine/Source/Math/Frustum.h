@@ -0,0 +1,38 @@
+#pragma once
+#include "glm/common.hpp"
+#include "glm/ext/vector_float3.hpp"
+#include "glm/ext/vector_float4.hpp"
+#include "glm/ext/matrix_float4x4.hpp"
+#include "glm/geometric.hpp"
+#include "AABB.h"
+
+struct Sphere
+{
+	glm::vec3 Center = glm::vec3(0.f);
+	float Radius = 0.f;
+};
+
+// Planes point inside, a point is inside the frustum if dot(Plane.xyz, P) + Plane.w >= 0 for all of them
+struct Frustum
+{
+	enum EPlane : uint8_t
+	{
+		Left,
+		Right,
+		Bottom,
+		Top,
+		Near,
+		Far,
+		Count
+	};
+
+	glm::vec4 Planes[EPlane::Count];
+
+	// Extracts the planes from a matrix to a [0, 1] depth clip space (Gribb-Hartmann)
+	// The planes are in the space the matrix transforms from, so passing a full object to clip matrix gives object space planes
+	static Frustum FromMatrix(const glm::mat4& inMatrix);
+
+	bool Intersects(const Sphere& inSphere) const;
+	// Conservative, boxes outside of the frustum but not fully outside of a single plane are kept
+	bool Intersects(const AABB& inBox) const;
+};
@@ -5,6 +5,14 @@
 #include "EASTL/vector.h"
 #include "glm/ext/vector_float3.hpp"
 
+// pdep is microcoded and slow on AMD CPUs before Zen 3, define MORTON_NO_PDEP when targeting those
+#if !defined(MORTON_NO_PDEP) && (defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__)))
+#define MORTON_USE_PDEP 1
+#include <immintrin.h>
+#else
+#define MORTON_USE_PDEP 0
+#endif
+
 inline uint16_t mortonEncode2_for(uint8_t x, uint8_t y)
 {
 	uint16_t answer = 0;
@@ -49,3 +57,13 @@ inline uint32_t MortonCode2(uint32_t x)
 
 	return x;
 }
+
+/** Interleaves the low 16 bits of x and y, x goes to the even bits. */
+inline uint32_t MortonEncode2(const uint32_t x, const uint32_t y)
+{
+#if MORTON_USE_PDEP
+	return _pdep_u32(x, 0x55555555) | _pdep_u32(y, 0xaaaaaaaa);
+#else
+	return MortonCode2(x) | (MortonCode2(y) << 1);
+#endif
+}
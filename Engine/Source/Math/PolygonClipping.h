@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+// Bare clip space positions, for polygons without attributes
+inline const glm::vec4& GetClipSpacePos(const glm::vec4& inVertex) { return inVertex; }
+inline glm::vec4 LerpVertex(const glm::vec4& inA, const glm::vec4& inB, const float inT) { return glm::mix(inA, inB, inT); }
+
+// One Sutherland-Hodgman pass, keeps the part of the polygon where dot(inPlane, GetClipSpacePos(vertex)) >= 0
+// Each pass adds at most one vertex, outVertices needs room for inNumVertices + 1 of them
+// Vertex types provide GetClipSpacePos and LerpVertex overloads, clip space attributes are linear so lerping them is exact
+template<typename VertexType>
+int32_t ClipPolygonAgainstPlane(const VertexType* inVertices, const int32_t inNumVertices, const glm::vec4& inPlane, VertexType* outVertices)
+{
+	int32_t numOut = 0;
+	for (int32_t i = 0; i < inNumVertices; ++i)
+	{
+		const VertexType& curr = inVertices[i];
+		const VertexType& next = inVertices[(i + 1) % inNumVertices];
+
+		const float currDist = glm::dot(inPlane, GetClipSpacePos(curr));
+		const float nextDist = glm::dot(inPlane, GetClipSpacePos(next));
+
+		if (currDist >= 0.f)
+		{
+			outVertices[numOut++] = curr;
+		}
+
+		if ((currDist >= 0.f) != (nextDist >= 0.f))
+		{
+			outVertices[numOut++] = LerpVertex(curr, next, currDist / (currDist - nextDist));
+		}
+	}
+
+	return numOut;
+}
@@ -0,0 +1,293 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// 8 wide SIMD types used by the software rasterizer pixel pipeline.
+// ISA is picked at compile time: AVX2 when the compiler targets it (/arch:AVX2), SSE2 on any x64 target and plain scalar code otherwise.
+// Define SIMD_FORCE_SCALAR to use the scalar code on any target.
+// Comparisons return lane masks with all bits set for true lanes, usable with And/Or/Select and MoveMask.
+
+#if defined(SIMD_FORCE_SCALAR)
+#define SIMD_SCALAR 1
+#define SIMD_ISA_NAME "Scalar"
+#elif defined(__AVX2__)
+#define SIMD_AVX2 1
+#define SIMD_ISA_NAME "AVX2"
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#define SIMD_ISA_NAME "SSE2"
+#include <emmintrin.h>
+#else
+#define SIMD_SCALAR 1
+#define SIMD_ISA_NAME "Scalar"
+#endif
+
+#ifndef SIMD_AVX2
+#define SIMD_AVX2 0
+#endif
+#ifndef SIMD_SSE
+#define SIMD_SSE 0
+#endif
+#ifndef SIMD_SCALAR
+#define SIMD_SCALAR 0
+#endif
+
+namespace SIMD
+{
+	constexpr int32_t Width = 8;
+
+#if SIMD_AVX2
+	struct Float8 { __m256 V; };
+	struct Int8 { __m256i V; };
+
+	inline Float8 Set1(const float inValue) { return { _mm256_set1_ps(inValue) }; }
+	inline Float8 Ramp() { return { _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f) }; }
+	inline Float8 LoadU(const float* inPtr) { return { _mm256_loadu_ps(inPtr) }; }
+	inline void StoreU(float* inPtr, const Float8& inValue) { _mm256_storeu_ps(inPtr, inValue.V); }
+
+	inline Float8 operator+(const Float8& A, const Float8& B) { return { _mm256_add_ps(A.V, B.V) }; }
+	inline Float8 operator-(const Float8& A, const Float8& B) { return { _mm256_sub_ps(A.V, B.V) }; }
+	inline Float8 operator*(const Float8& A, const Float8& B) { return { _mm256_mul_ps(A.V, B.V) }; }
+	inline Float8 operator/(const Float8& A, const Float8& B) { return { _mm256_div_ps(A.V, B.V) }; }
+
+	inline Float8 CmpGE(const Float8& A, const Float8& B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_GE_OQ) }; }
+	inline Float8 CmpGT(const Float8& A, const Float8& B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_GT_OQ) }; }
+	inline Float8 CmpLE(const Float8& A, const Float8& B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_LE_OQ) }; }
+	inline Float8 CmpLT(const Float8& A, const Float8& B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_LT_OQ) }; }
+
+	inline Float8 Min(const Float8& A, const Float8& B) { return { _mm256_min_ps(A.V, B.V) }; }
+	inline Float8 Max(const Float8& A, const Float8& B) { return { _mm256_max_ps(A.V, B.V) }; }
+
+	inline Float8 And(const Float8& A, const Float8& B) { return { _mm256_and_ps(A.V, B.V) }; }
+	inline Float8 Or(const Float8& A, const Float8& B) { return { _mm256_or_ps(A.V, B.V) }; }
+	// inMask ? A : B
+	inline Float8 Select(const Float8& inMask, const Float8& A, const Float8& B) { return { _mm256_blendv_ps(B.V, A.V, inMask.V) }; }
+	inline uint32_t MoveMask(const Float8& inMask) { return static_cast<uint32_t>(_mm256_movemask_ps(inMask.V)); }
+
+	inline Int8 LoadU(const uint32_t* inPtr) { return { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inPtr)) }; }
+	inline void StoreU(uint32_t* inPtr, const Int8& inValue) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(inPtr), inValue.V); }
+	inline Int8 Select(const Float8& inMask, const Int8& A, const Int8& B) { return { _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(B.V), _mm256_castsi256_ps(A.V), inMask.V)) }; }
+
+	inline Int8 Set1Int(const int32_t inValue) { return { _mm256_set1_epi32(inValue) }; }
+	inline Int8 operator+(const Int8& A, const Int8& B) { return { _mm256_add_epi32(A.V, B.V) }; }
+	inline Int8 Or(const Int8& A, const Int8& B) { return { _mm256_or_si256(A.V, B.V) }; }
+	inline Int8 And(const Int8& A, const Int8& B) { return { _mm256_and_si256(A.V, B.V) }; }
+	// Logical shifts, zeros are shifted in
+	inline Int8 ShiftLeft(const Int8& inValue, const int32_t inBits) { return { _mm256_sll_epi32(inValue.V, _mm_cvtsi32_si128(inBits)) }; }
+	inline Int8 ShiftRight(const Int8& inValue, const int32_t inBits) { return { _mm256_srl_epi32(inValue.V, _mm_cvtsi32_si128(inBits)) }; }
+	// Lane i is inTable[inIndices[i]]
+	inline Int8 Gather(const uint32_t* inTable, const Int8& inIndices) { return { _mm256_i32gather_epi32(reinterpret_cast<const int*>(inTable), inIndices.V, 4) }; }
+	// Sign bit of each lane
+	inline uint32_t MoveMask(const Int8& inValue) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(inValue.V))); }
+	inline Float8 ToFloat(const Int8& inValue) { return { _mm256_cvtepi32_ps(inValue.V) }; }
+	// Same bits seen as floats
+	inline Float8 AsFloat(const Int8& inValue) { return { _mm256_castsi256_ps(inValue.V) }; }
+	// Rounds towards zero, out of range lanes give INT32_MIN
+	inline Int8 ToIntTruncate(const Float8& inValue) { return { _mm256_cvttps_epi32(inValue.V) }; }
+
+	// 16 bit lanes are zero extended on load, stores expect lanes already within 0..65535
+	inline Int8 LoadU(const uint16_t* inPtr) { return { _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inPtr))) }; }
+	inline void StoreU(uint16_t* inPtr, const Int8& inValue)
+	{
+		const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(inValue.V), _mm256_extracti128_si256(inValue.V, 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(inPtr), packed);
+	}
+
+	// Lane i is true when bit i of inBits is set
+	inline Float8 MaskFromBits(const uint32_t inBits)
+	{
+		const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		const __m256i bits = _mm256_and_si256(_mm256_set1_epi32(static_cast<int32_t>(inBits)), laneBits);
+		return { _mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, laneBits)) };
+	}
+
+#elif SIMD_SSE
+	struct Float8 { __m128 Lo; __m128 Hi; };
+	struct Int8 { __m128i Lo; __m128i Hi; };
+
+	inline Float8 Set1(const float inValue) { const __m128 v = _mm_set1_ps(inValue); return { v, v }; }
+	inline Float8 Ramp() { return { _mm_setr_ps(0.f, 1.f, 2.f, 3.f), _mm_setr_ps(4.f, 5.f, 6.f, 7.f) }; }
+	inline Float8 LoadU(const float* inPtr) { return { _mm_loadu_ps(inPtr), _mm_loadu_ps(inPtr + 4) }; }
+	inline void StoreU(float* inPtr, const Float8& inValue) { _mm_storeu_ps(inPtr, inValue.Lo); _mm_storeu_ps(inPtr + 4, inValue.Hi); }
+
+	inline Float8 operator+(const Float8& A, const Float8& B) { return { _mm_add_ps(A.Lo, B.Lo), _mm_add_ps(A.Hi, B.Hi) }; }
+	inline Float8 operator-(const Float8& A, const Float8& B) { return { _mm_sub_ps(A.Lo, B.Lo), _mm_sub_ps(A.Hi, B.Hi) }; }
+	inline Float8 operator*(const Float8& A, const Float8& B) { return { _mm_mul_ps(A.Lo, B.Lo), _mm_mul_ps(A.Hi, B.Hi) }; }
+	inline Float8 operator/(const Float8& A, const Float8& B) { return { _mm_div_ps(A.Lo, B.Lo), _mm_div_ps(A.Hi, B.Hi) }; }
+
+	inline Float8 CmpGE(const Float8& A, const Float8& B) { return { _mm_cmpge_ps(A.Lo, B.Lo), _mm_cmpge_ps(A.Hi, B.Hi) }; }
+	inline Float8 CmpGT(const Float8& A, const Float8& B) { return { _mm_cmpgt_ps(A.Lo, B.Lo), _mm_cmpgt_ps(A.Hi, B.Hi) }; }
+	inline Float8 CmpLE(const Float8& A, const Float8& B) { return { _mm_cmple_ps(A.Lo, B.Lo), _mm_cmple_ps(A.Hi, B.Hi) }; }
+	inline Float8 CmpLT(const Float8& A, const Float8& B) { return { _mm_cmplt_ps(A.Lo, B.Lo), _mm_cmplt_ps(A.Hi, B.Hi) }; }
+
+	inline Float8 Min(const Float8& A, const Float8& B) { return { _mm_min_ps(A.Lo, B.Lo), _mm_min_ps(A.Hi, B.Hi) }; }
+	inline Float8 Max(const Float8& A, const Float8& B) { return { _mm_max_ps(A.Lo, B.Lo), _mm_max_ps(A.Hi, B.Hi) }; }
+
+	inline Float8 And(const Float8& A, const Float8& B) { return { _mm_and_ps(A.Lo, B.Lo), _mm_and_ps(A.Hi, B.Hi) }; }
+	inline Float8 Or(const Float8& A, const Float8& B) { return { _mm_or_ps(A.Lo, B.Lo), _mm_or_ps(A.Hi, B.Hi) }; }
+	// inMask ? A : B, SSE2 has no blend so do it with bit ops
+	inline __m128 SelectHalf(const __m128 inMask, const __m128 A, const __m128 B) { return _mm_or_ps(_mm_and_ps(inMask, A), _mm_andnot_ps(inMask, B)); }
+	inline Float8 Select(const Float8& inMask, const Float8& A, const Float8& B) { return { SelectHalf(inMask.Lo, A.Lo, B.Lo), SelectHalf(inMask.Hi, A.Hi, B.Hi) }; }
+	inline uint32_t MoveMask(const Float8& inMask) { return static_cast<uint32_t>(_mm_movemask_ps(inMask.Lo) | (_mm_movemask_ps(inMask.Hi) << 4)); }
+
+	inline Int8 LoadU(const uint32_t* inPtr) { return { _mm_loadu_si128(reinterpret_cast<const __m128i*>(inPtr)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(inPtr + 4)) }; }
+	inline void StoreU(uint32_t* inPtr, const Int8& inValue) { _mm_storeu_si128(reinterpret_cast<__m128i*>(inPtr), inValue.Lo); _mm_storeu_si128(reinterpret_cast<__m128i*>(inPtr + 4), inValue.Hi); }
+	inline Int8 Select(const Float8& inMask, const Int8& A, const Int8& B)
+	{
+		return { _mm_castps_si128(SelectHalf(inMask.Lo, _mm_castsi128_ps(A.Lo), _mm_castsi128_ps(B.Lo))), _mm_castps_si128(SelectHalf(inMask.Hi, _mm_castsi128_ps(A.Hi), _mm_castsi128_ps(B.Hi))) };
+	}
+
+	inline Int8 Set1Int(const int32_t inValue) { const __m128i v = _mm_set1_epi32(inValue); return { v, v }; }
+	inline Int8 operator+(const Int8& A, const Int8& B) { return { _mm_add_epi32(A.Lo, B.Lo), _mm_add_epi32(A.Hi, B.Hi) }; }
+	inline Int8 Or(const Int8& A, const Int8& B) { return { _mm_or_si128(A.Lo, B.Lo), _mm_or_si128(A.Hi, B.Hi) }; }
+	inline Int8 And(const Int8& A, const Int8& B) { return { _mm_and_si128(A.Lo, B.Lo), _mm_and_si128(A.Hi, B.Hi) }; }
+	// Logical shifts, zeros are shifted in
+	inline Int8 ShiftLeft(const Int8& inValue, const int32_t inBits) { const __m128i bits = _mm_cvtsi32_si128(inBits); return { _mm_sll_epi32(inValue.Lo, bits), _mm_sll_epi32(inValue.Hi, bits) }; }
+	inline Int8 ShiftRight(const Int8& inValue, const int32_t inBits) { const __m128i bits = _mm_cvtsi32_si128(inBits); return { _mm_srl_epi32(inValue.Lo, bits), _mm_srl_epi32(inValue.Hi, bits) }; }
+	// Lane i is inTable[inIndices[i]], SSE2 has no gather so lanes are loaded one by one
+	inline Int8 Gather(const uint32_t* inTable, const Int8& inIndices)
+	{
+		alignas(16) uint32_t indices[Width];
+		alignas(16) uint32_t values[Width];
+		_mm_store_si128(reinterpret_cast<__m128i*>(indices), inIndices.Lo);
+		_mm_store_si128(reinterpret_cast<__m128i*>(indices + 4), inIndices.Hi);
+		for (int32_t i = 0; i < Width; ++i)
+		{
+			values[i] = inTable[indices[i]];
+		}
+		return { _mm_load_si128(reinterpret_cast<const __m128i*>(values)), _mm_load_si128(reinterpret_cast<const __m128i*>(values + 4)) };
+	}
+	// Sign bit of each lane
+	inline uint32_t MoveMask(const Int8& inValue) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(inValue.Lo)) | (_mm_movemask_ps(_mm_castsi128_ps(inValue.Hi)) << 4)); }
+	inline Float8 ToFloat(const Int8& inValue) { return { _mm_cvtepi32_ps(inValue.Lo), _mm_cvtepi32_ps(inValue.Hi) }; }
+	inline Float8 AsFloat(const Int8& inValue) { return { _mm_castsi128_ps(inValue.Lo), _mm_castsi128_ps(inValue.Hi) }; }
+	// Rounds towards zero, out of range lanes give INT32_MIN
+	inline Int8 ToIntTruncate(const Float8& inValue) { return { _mm_cvttps_epi32(inValue.Lo), _mm_cvttps_epi32(inValue.Hi) }; }
+
+	// 16 bit lanes are zero extended on load, stores expect lanes already within 0..65535
+	inline Int8 LoadU(const uint16_t* inPtr)
+	{
+		const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inPtr));
+		return { _mm_unpacklo_epi16(value, _mm_setzero_si128()), _mm_unpackhi_epi16(value, _mm_setzero_si128()) };
+	}
+	inline void StoreU(uint16_t* inPtr, const Int8& inValue)
+	{
+		// SSE2 only has a signed saturating pack, bias into the signed range and back
+		const __m128i bias32 = _mm_set1_epi32(0x8000);
+		const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(inValue.Lo, bias32), _mm_sub_epi32(inValue.Hi, bias32));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(inPtr), _mm_xor_si128(packed, _mm_set1_epi16(static_cast<int16_t>(0x8000))));
+	}
+
+	// Lane i is true when bit i of inBits is set
+	inline Float8 MaskFromBits(const uint32_t inBits)
+	{
+		const __m128i bits = _mm_set1_epi32(static_cast<int32_t>(inBits));
+		const __m128i laneBitsLo = _mm_setr_epi32(1, 2, 4, 8);
+		const __m128i laneBitsHi = _mm_setr_epi32(16, 32, 64, 128);
+		return { _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(bits, laneBitsLo), laneBitsLo)), _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(bits, laneBitsHi), laneBitsHi)) };
+	}
+
+#else
+	// Scalar fallback, masks are kept as full bit patterns in uint32 lanes
+	struct Float8 { float V[Width]; };
+	struct Int8 { uint32_t V[Width]; };
+
+	inline uint32_t AsBits(const float inValue) { uint32_t bits; memcpy(&bits, &inValue, sizeof(bits)); return bits; }
+	inline float AsFloat(const uint32_t inBits) { float value; memcpy(&value, &inBits, sizeof(value)); return value; }
+	inline float MaskLane(const bool inValue) { return AsFloat(inValue ? 0xffffffffu : 0u); }
+
+	inline Float8 Set1(const float inValue) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = inValue; } return r; }
+	inline Float8 Ramp() { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = static_cast<float>(i); } return r; }
+	inline Float8 LoadU(const float* inPtr) { Float8 r; memcpy(r.V, inPtr, sizeof(r.V)); return r; }
+	inline void StoreU(float* inPtr, const Float8& inValue) { memcpy(inPtr, inValue.V, sizeof(inValue.V)); }
+
+	inline Float8 operator+(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = A.V[i] + B.V[i]; } return r; }
+	inline Float8 operator-(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = A.V[i] - B.V[i]; } return r; }
+	inline Float8 operator*(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = A.V[i] * B.V[i]; } return r; }
+	inline Float8 operator/(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = A.V[i] / B.V[i]; } return r; }
+
+	inline Float8 CmpGE(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = MaskLane(A.V[i] >= B.V[i]); } return r; }
+	inline Float8 CmpGT(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = MaskLane(A.V[i] > B.V[i]); } return r; }
+	inline Float8 CmpLE(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = MaskLane(A.V[i] <= B.V[i]); } return r; }
+	inline Float8 CmpLT(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = MaskLane(A.V[i] < B.V[i]); } return r; }
+
+	inline Float8 Min(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = B.V[i] < A.V[i] ? B.V[i] : A.V[i]; } return r; }
+	inline Float8 Max(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = A.V[i] < B.V[i] ? B.V[i] : A.V[i]; } return r; }
+
+	inline Float8 And(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = AsFloat(AsBits(A.V[i]) & AsBits(B.V[i])); } return r; }
+	inline Float8 Or(const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = AsFloat(AsBits(A.V[i]) | AsBits(B.V[i])); } return r; }
+	// inMask ? A : B
+	inline Float8 Select(const Float8& inMask, const Float8& A, const Float8& B) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = AsBits(inMask.V[i]) ? A.V[i] : B.V[i]; } return r; }
+	inline uint32_t MoveMask(const Float8& inMask) { uint32_t r = 0; for (int32_t i = 0; i < Width; ++i) { r |= (AsBits(inMask.V[i]) >> 31) << i; } return r; }
+
+	inline Int8 LoadU(const uint32_t* inPtr) { Int8 r; memcpy(r.V, inPtr, sizeof(r.V)); return r; }
+	inline void StoreU(uint32_t* inPtr, const Int8& inValue) { memcpy(inPtr, inValue.V, sizeof(inValue.V)); }
+	inline Int8 Select(const Float8& inMask, const Int8& A, const Int8& B) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = AsBits(inMask.V[i]) ? A.V[i] : B.V[i]; } return r; }
+
+	inline Int8 Set1Int(const int32_t inValue) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = static_cast<uint32_t>(inValue); } return r; }
+	// Wraps like the SIMD integer adds
+	inline Int8 operator+(const Int8& A, const Int8& B) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = A.V[i] + B.V[i]; } return r; }
+	inline Int8 Or(const Int8& A, const Int8& B) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = A.V[i] | B.V[i]; } return r; }
+	inline Int8 And(const Int8& A, const Int8& B) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = A.V[i] & B.V[i]; } return r; }
+	// Logical shifts, zeros are shifted in
+	inline Int8 ShiftLeft(const Int8& inValue, const int32_t inBits) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = inValue.V[i] << inBits; } return r; }
+	inline Int8 ShiftRight(const Int8& inValue, const int32_t inBits) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = inValue.V[i] >> inBits; } return r; }
+	// Lane i is inTable[inIndices[i]]
+	inline Int8 Gather(const uint32_t* inTable, const Int8& inIndices) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = inTable[inIndices.V[i]]; } return r; }
+	// Sign bit of each lane
+	inline uint32_t MoveMask(const Int8& inValue) { uint32_t r = 0; for (int32_t i = 0; i < Width; ++i) { r |= (inValue.V[i] >> 31) << i; } return r; }
+	inline Float8 ToFloat(const Int8& inValue) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = static_cast<float>(static_cast<int32_t>(inValue.V[i])); } return r; }
+	inline Float8 AsFloat(const Int8& inValue) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = AsFloat(inValue.V[i]); } return r; }
+	// Rounds towards zero, out of range lanes give INT32_MIN
+	inline Int8 ToIntTruncate(const Float8& inValue)
+	{
+		Int8 r;
+		for (int32_t i = 0; i < Width; ++i)
+		{
+			const float v = inValue.V[i];
+			r.V[i] = (v > -2147483648.f && v < 2147483648.f) ? static_cast<uint32_t>(static_cast<int32_t>(v)) : 0x80000000u;
+		}
+		return r;
+	}
+
+	// 16 bit lanes are zero extended on load, stores expect lanes already within 0..65535
+	inline Int8 LoadU(const uint16_t* inPtr) { Int8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = inPtr[i]; } return r; }
+	inline void StoreU(uint16_t* inPtr, const Int8& inValue) { for (int32_t i = 0; i < Width; ++i) { inPtr[i] = static_cast<uint16_t>(inValue.V[i]); } }
+
+	// Lane i is true when bit i of inBits is set
+	inline Float8 MaskFromBits(const uint32_t inBits) { Float8 r; for (int32_t i = 0; i < Width; ++i) { r.V[i] = MaskLane((inBits >> i) & 1u); } return r; }
+#endif
+
+	inline Float8& operator+=(Float8& A, const Float8& B) { A = A + B; return A; }
+	inline Int8& operator+=(Int8& A, const Int8& B) { A = A + B; return A; }
+
+	// Horizontal reductions, not meant for inner loops
+	inline float ReduceMax(const Float8& inValue)
+	{
+		alignas(32) float lanes[Width];
+		StoreU(lanes, inValue);
+
+		float result = lanes[0];
+		for (int32_t i = 1; i < Width; ++i)
+		{
+			result = lanes[i] > result ? lanes[i] : result;
+		}
+
+		return result;
+	}
+
+	inline float ReduceMin(const Float8& inValue)
+	{
+		alignas(32) float lanes[Width];
+		StoreU(lanes, inValue);
+
+		float result = lanes[0];
+		for (int32_t i = 1; i < Width; ++i)
+		{
+			result = lanes[i] < result ? lanes[i] : result;
+		}
+
+		return result;
+	}
+}
@@ -201,6 +201,28 @@ void AssimpModel3D::ProcessMesh(const aiMesh& inMesh, const aiScene& inScene, ea
 
 		newMesh->CPUVertices.resize(cpuVertices.size());
 		memcpy(&newMesh->CPUVertices[0], (float*)cpuVertices.data(), vertexBufferSize);
+
+		// Bounds, sphere is centered on the box
+		for (const SimpleVertex& cpuVert : cpuVertices)
+		{
+			newMesh->BoundingBox += cpuVert.Position;
+		}
+
+		if (newMesh->BoundingBox.IsValid())
+		{
+			glm::vec3 boxCenter, boxExtent;
+			newMesh->BoundingBox.GetCenterAndExtent(boxCenter, boxExtent);
+
+			float maxDistSquared = 0.f;
+			for (const SimpleVertex& cpuVert : cpuVertices)
+			{
+				const glm::vec3 toVert = cpuVert.Position - boxCenter;
+				maxDistSquared = glm::max(maxDistSquared, glm::dot(toVert, toVert));
+			}
+
+			newMesh->BoundingSphere.Center = boxCenter;
+			newMesh->BoundingSphere.Radius = glm::sqrt(maxDistSquared);
+		}
 	}
 
 	newMesh->IndexBuffer = indexBuffer;
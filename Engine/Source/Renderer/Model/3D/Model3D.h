@@ -3,6 +3,8 @@
 #include "Entity/TransformObject.h"
 #include "Renderer/Drawable/Drawable.h"
 #include "Renderer/RHI/D3D12/D3D12Resources.h"
+#include "Math/AABB.h"
+#include "Math/Frustum.h"
 
 struct MeshMaterial
 {
@@ -25,6 +27,11 @@ struct MeshNode : public DrawableObject
 
 	eastl::vector<SimpleVertex> CPUVertices;
 	eastl::vector<uint32_t> CPUIndices;
+
+	// Object space bounds of CPUVertices, used for culling whole nodes
+	// Nodes without valid bounds are never culled
+	AABB BoundingBox;
+	Sphere BoundingSphere;
 };
 
 class Model3D : public TransformObject
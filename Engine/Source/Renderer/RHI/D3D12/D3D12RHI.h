@@ -1,6 +1,7 @@
 #pragma once
 #include "Renderer/RHI/RHITypes.h"
 #include "EASTL/string.h"
+#include "EASTL/functional.h"
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include "D3D12GraphicsTypes_Internal.h"
@@ -66,6 +67,9 @@ struct CompiledShaderResult
 	}
 };
 
+// Fills a single subresource texture in upload memory, rows are inRowPitch bytes apart
+using TextureUploadWriter = eastl::function<void(uint8_t* outTexels, const uint64_t inRowPitch)>;
+
 class D3D12RHI
 {
 public:
@@ -90,6 +94,8 @@ public:
 	eastl::shared_ptr<class D3D12VertexBuffer> CreateVertexBuffer(const class VertexInputLayout& inLayout, const float* inVertices, const int32_t inCount, eastl::shared_ptr<class D3D12IndexBuffer> inIndexBuffer = nullptr);
 
 	void UpdateTexture2D(eastl::shared_ptr<D3D12Texture2D>& inTexture, const uint32_t* inData, const uint32_t inWidth, const uint32_t inHeight, ID3D12GraphicsCommandList* inCommandList);
+	// Same, but the texels are written by inWriter straight into the upload buffer, saving a copy of the whole texture
+	void UpdateTexture2D(eastl::shared_ptr<D3D12Texture2D>& inTexture, const TextureUploadWriter& inWriter, ID3D12GraphicsCommandList* inCommandList);
 	eastl::shared_ptr<class D3D12Texture2D> CreateTexture2D(const uint32_t inWidth, const uint32_t inHeight, const bool inSRGB, ID3D12GraphicsCommandList* inCommandList, const uint32_t* inData = nullptr);
 
 	eastl::shared_ptr<class D3D12Texture2D> CreateAndLoadTexture2D(const eastl::string& inDataPath, const bool inSRGB, const bool bGenerateMipMaps, struct ID3D12GraphicsCommandList* inCommandList);
@@ -155,7 +155,8 @@ D3D12_VERTEX_BUFFER_VIEW D3D12VertexBuffer::VBView() const
 }
 
 
-void UploadTextureRaw(ID3D12Resource* inDestResource, const uint32_t* inRawData, UploadContext& inContext, const uint32_t inWidth, const uint32_t inHeight)
+// Lets inWriter fill the staging upload heap in the footprint the device expects, then copies it to the texture
+void UploadTextureFromWriter(ID3D12Resource* inDestResource, const TextureUploadWriter& inWriter, UploadContext& inContext)
 {
 	const uint32_t numMips = 1u;
 	uint32_t NumSubresources = numMips;
@@ -187,30 +188,17 @@ void UploadTextureRaw(ID3D12Resource* inDestResource, const uint32_t* inRawData,
 
 	ASSERT(isCopyValid);
 
-	uint32_t* uploadMem = reinterpret_cast<uint32_t*>(inContext.CPUAddress);
+	uint8_t* uploadMem = reinterpret_cast<uint8_t*>(inContext.CPUAddress);
 
-	// Copy to the staging upload heap
+	// Write to the staging upload heap
 	{
 		ASSERT(rowSize[0] <= size_t(-1));
 
 		const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& mipSubresourceLayout = layouts[0];
-		const uint64_t subResourceHeight = numRows[0];
-		const uint64_t subResourcePitch = mipSubresourceLayout.Footprint.RowPitch;
-		const uint64_t subResourceDepth = mipSubresourceLayout.Footprint.Depth;
 
 		ASSERT(mipSubresourceLayout.Offset == 0); // We don't take offset into consideration so make sure it's 0
 
-		uint32_t* dstSubresourceMem = uploadMem;
-
-		const uint32_t* srcSubImageTexels = inRawData;
-		const uint64_t rowPitch = inWidth * 4; // Width size in bytes
-
-		for (uint64_t y = 0; y < subResourceHeight; ++y)
-		{
-			memcpy(dstSubresourceMem, srcSubImageTexels, glm::min(subResourcePitch, rowPitch));
-			dstSubresourceMem += (subResourcePitch / 4);
-			srcSubImageTexels += (inWidth);
-		}
+		inWriter(uploadMem, mipSubresourceLayout.Footprint.RowPitch);
 	}
 
 	// Copy to the upload buffer
@@ -232,6 +220,22 @@ void UploadTextureRaw(ID3D12Resource* inDestResource, const uint32_t* inRawData,
 	}
 }
 
+void UploadTextureRaw(ID3D12Resource* inDestResource, const uint32_t* inRawData, UploadContext& inContext, const uint32_t inWidth, const uint32_t inHeight)
+{
+	UploadTextureFromWriter(inDestResource, [inRawData, inWidth, inHeight](uint8_t* outTexels, const uint64_t inRowPitch)
+		{
+			const uint32_t* srcSubImageTexels = inRawData;
+			const uint64_t rowPitch = inWidth * 4; // Width size in bytes
+
+			for (uint32_t y = 0; y < inHeight; ++y)
+			{
+				memcpy(outTexels, srcSubImageTexels, glm::min(inRowPitch, rowPitch));
+				outTexels += inRowPitch;
+				srcSubImageTexels += inWidth;
+			}
+		}, inContext);
+}
+
 void UploadTexture(ID3D12Resource* inDestResource, DirectX::ScratchImage& inRes, UploadContext& inContext)
 {
 	const uint32_t numMips = (uint32_t)(inRes.GetImageCount());
@@ -381,6 +385,20 @@ void D3D12RHI::UpdateTexture2D(eastl::shared_ptr<D3D12Texture2D>& inTexture, con
 	D3D12Upload::ResourceUploadEnd(uploadcontext);
 }
 
+void D3D12RHI::UpdateTexture2D(eastl::shared_ptr<D3D12Texture2D>& inTexture, const TextureUploadWriter& inWriter, ID3D12GraphicsCommandList* inCommandList)
+{
+	ID3D12Resource* texResource = inTexture->Resource;
+	const D3D12_RESOURCE_DESC textureDesc = texResource->GetDesc();
+
+	UINT64 uploadBufferSize = 0;
+	D3D12Globals::Device->GetCopyableFootprints(&textureDesc, 0, 1, 0, nullptr, nullptr, nullptr, &uploadBufferSize);
+
+	UploadContext& uploadcontext = D3D12Upload::ResourceUploadBegin(uploadBufferSize);
+	UploadTextureFromWriter(texResource, inWriter, uploadcontext);
+
+	D3D12Upload::ResourceUploadEnd(uploadcontext);
+}
+
 eastl::shared_ptr<D3D12Texture2D> D3D12RHI::CreateTexture2D(const uint32_t inWidth, const uint32_t inHeight, const bool inSRGB, ID3D12GraphicsCommandList* inCommandList, const uint32_t* inData)
 {
 	eastl::shared_ptr<D3D12Texture2D> newTexture = eastl::make_shared<D3D12Texture2D>();
@@ -478,6 +496,17 @@ eastl::shared_ptr<D3D12Texture2D> D3D12RHI::CreateAndLoadTexture2D(const eastl::
 
 	ENSURE(success);
 
+	// The software rasterizer samples the CPU copy, it gets the full mip chain
+	if (bGenerateMipMaps)
+	{
+		DirectX::ScratchImage mipChain;
+		const DirectX::TEX_FILTER_FLAGS mipFilter = inSRGB ? DirectX::TEX_FILTER_SRGB : DirectX::TEX_FILTER_DEFAULT;
+		if (SUCCEEDED(DirectX::GenerateMipMaps(*dxImage.GetImage(0, 0, 0), mipFilter, 0, mipChain, false)))
+		{
+			dxImage = std::move(mipChain);
+		}
+	}
+
 	//DirectX::ScratchImage* finalImage = &dxImage;
 
 	//DirectX::ScratchImage mipMapRes;
@@ -550,6 +579,7 @@ eastl::shared_ptr<D3D12Texture2D> D3D12RHI::CreateAndLoadTexture2D(const eastl::
 	newTexture->SourcePath = inDataPath;
 	newTexture->TextureType = ETextureType::Single;
 	//newTexture->Resource = texResource;
+	newTexture->SwizzledCPUImage.Init(dxImage);
 	newTexture->CPUImage = std::move(dxImage);
 
 	return newTexture;
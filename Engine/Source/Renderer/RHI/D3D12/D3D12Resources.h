@@ -6,6 +6,7 @@
 #include "Renderer/RHI/Resources/RHITexture.h"
 #include "D3D12Utility.h"
 #include "DirectXTex.h"
+#include "Renderer/SwizzledTexture.h"
 
 class D3D12IndexBuffer : public RHIIndexBuffer
 {
@@ -42,6 +43,8 @@ public:
 	ID3D12Resource* Resource = nullptr;
 	uint32_t SRVIndex = -1;
 	DirectX::ScratchImage CPUImage;
+	// CPUImage in the layout the software rasterizer samples
+	SwizzledTexture SwizzledCPUImage;
 };
 
 // Texture that can be updated each frame
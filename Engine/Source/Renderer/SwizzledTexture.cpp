@@ -0,0 +1,61 @@
+#include "Renderer/SwizzledTexture.h"
+#include "DirectXTex.h"
+#include "EASTL/algorithm.h"
+#include <string.h>
+
+// 32x32 tiles of 4 byte texels are 4KB, a page, smaller mips get a single tile that fits them
+constexpr uint32_t MAX_TILE_SIZE_LOG2 = 5;
+
+void SwizzledTexture::Init(const DirectX::ScratchImage& inImage)
+{
+	Texels.clear();
+	Mips.clear();
+
+	const DirectX::Image* images = inImage.GetImages();
+	const int32_t numMips = static_cast<int32_t>(inImage.GetImageCount());
+
+	// Offsets first, texel pointers are only known once the storage stops growing
+	eastl::vector<size_t> mipOffsets;
+	for (int32_t mipIdx = 0; mipIdx < numMips; ++mipIdx)
+	{
+		const DirectX::Image& image = images[mipIdx];
+		ASSERT(DirectX::BitsPerPixel(image.format) == 32);
+
+		SwizzledMip mip;
+		mip.Width = static_cast<int32_t>(image.width);
+		mip.Height = static_cast<int32_t>(image.height);
+
+		const int32_t largestSide = eastl::max(mip.Width, mip.Height);
+		while (mip.TileSizeLog2 < MAX_TILE_SIZE_LOG2 && (1 << mip.TileSizeLog2) < largestSide)
+		{
+			++mip.TileSizeLog2;
+		}
+
+		const int32_t tileSize = 1 << mip.TileSizeLog2;
+		mip.TilesPerRow = (mip.Width + tileSize - 1) / tileSize;
+		const int32_t tilesPerColumn = (mip.Height + tileSize - 1) / tileSize;
+
+		mipOffsets.push_back(Texels.size());
+		Texels.resize(Texels.size() + size_t(mip.TilesPerRow) * tilesPerColumn * tileSize * tileSize, 0u);
+		Mips.push_back(mip);
+	}
+
+	for (int32_t mipIdx = 0; mipIdx < numMips; ++mipIdx)
+	{
+		const DirectX::Image& image = images[mipIdx];
+		SwizzledMip& mip = Mips[mipIdx];
+		mip.Texels = &Texels[mipOffsets[mipIdx]];
+
+		uint32_t* texels = &Texels[mipOffsets[mipIdx]];
+		const uint32_t tileMask = (1u << mip.TileSizeLog2) - 1;
+		for (int32_t y = 0; y < mip.Height; ++y)
+		{
+			const uint8_t* row = image.pixels + y * image.rowPitch;
+			for (int32_t x = 0; x < mip.Width; ++x)
+			{
+				const uint32_t tileIdx = (y >> mip.TileSizeLog2) * mip.TilesPerRow + (x >> mip.TileSizeLog2);
+				memcpy(&texels[(tileIdx << (2 * mip.TileSizeLog2)) | MortonEncode2(x & tileMask, y & tileMask)], row + x * 4, sizeof(uint32_t));
+			}
+		}
+	}
+}
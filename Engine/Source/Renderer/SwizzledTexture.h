@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include "EASTL/vector.h"
+#include "Math/MortonCode.h"
+
+namespace DirectX
+{
+	class ScratchImage;
+}
+
+// One mip of a SwizzledTexture
+// The mip is cut in square tiles stored one after the other, row by row, texels inside a tile follow the Z-order curve
+struct SwizzledMip
+{
+	const uint32_t* Texels = nullptr;
+	int32_t Width = 0;
+	int32_t Height = 0;
+	uint32_t TileSizeLog2 = 0;
+	int32_t TilesPerRow = 0;
+
+	inline uint32_t Fetch(const int32_t inX, const int32_t inY) const
+	{
+		const uint32_t tileMask = (1u << TileSizeLog2) - 1;
+		const uint32_t tileIdx = (inY >> TileSizeLog2) * TilesPerRow + (inX >> TileSizeLog2);
+
+		return Texels[(tileIdx << (2 * TileSizeLog2)) | MortonEncode2(inX & tileMask, inY & tileMask)];
+	}
+};
+
+// Copy of a 4 bytes per texel texture with all of its mips swizzled, for the software rasterizer's sampler
+// With row-linear storage, texels stepping along V are a row pitch apart. In Z-order an aligned 4x4 block is a single 64 byte line
+// and neighbours are close along both axes, so rotated and perspective-mapped textures touch far fewer lines
+class SwizzledTexture
+{
+public:
+	SwizzledTexture() = default;
+	// Mips point into Texels
+	SwizzledTexture(const SwizzledTexture&) = delete;
+	SwizzledTexture& operator=(const SwizzledTexture&) = delete;
+	SwizzledTexture(SwizzledTexture&&) = default;
+	SwizzledTexture& operator=(SwizzledTexture&&) = default;
+
+	void Init(const DirectX::ScratchImage& inImage);
+
+	inline bool IsValid() const { return !Mips.empty(); }
+	inline int32_t GetNumMips() const { return static_cast<int32_t>(Mips.size()); }
+	inline const SwizzledMip& GetMip(const int32_t inMipIdx) const { return Mips[inMipIdx]; }
+
+private:
+	eastl::vector<uint32_t> Texels;
+	eastl::vector<SwizzledMip> Mips;
+};
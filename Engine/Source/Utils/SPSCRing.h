@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include "EASTL/utility.h"
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread
+// Head and Tail only ever increase and wrap around uint32, their difference is the number of elements
+template<typename T, uint32_t Capacity>
+class TSPSCRing
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+public:
+	// Producer thread only, returns false if the ring is full
+	bool TryPush(const T& inValue)
+	{
+		const uint32_t tail = Tail.load(std::memory_order_relaxed);
+		if (tail - Head.load(std::memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+
+		Elements[tail & (Capacity - 1)] = inValue;
+		Tail.store(tail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// Consumer thread only, returns false if the ring is empty
+	bool TryPop(T& outValue)
+	{
+		const uint32_t head = Head.load(std::memory_order_relaxed);
+		if (head == Tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		outValue = eastl::move(Elements[head & (Capacity - 1)]);
+		Head.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+private:
+	T Elements[Capacity];
+
+	// On separate cache lines so the two threads do not keep stealing each other's line
+	alignas(64) std::atomic<uint32_t> Head{ 0 };
+	alignas(64) std::atomic<uint32_t> Tail{ 0 };
+};